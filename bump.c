@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/arena.h"
+#include "lib/utils.h"
+
+#define NUM_THREADS 8
+#define REQUESTS 20000
+#define ALLOCS_PER_REQUEST 32
+
+// request-scoped allocations: a bunch of small objects, all dropped at the end of the request
+bool use_arena = false;
+volatile unsigned long sink;
+
+void* serve(void* arg) {
+    void* objects[ALLOCS_PER_REQUEST];
+    unsigned seed = (unsigned long)arg;
+
+    for (int r = 0; r < REQUESTS; r++) {
+        for (int i = 0; i < ALLOCS_PER_REQUEST; i++) {
+            size_t size = 16 + (rand_r(&seed) % 496);
+            if (use_arena) {
+                objects[i] = ult_arena_alloc(size);
+            } else {
+                // glibc skips its locks in a single threaded process: a ULT preempted
+                // inside malloc would corrupt the heap for the next one
+                block_signals();
+                objects[i] = malloc(size);
+                unblock_signals();
+            }
+            memset(objects[i], i, 16);
+        }
+        sink += ((unsigned char*)objects[r % ALLOCS_PER_REQUEST])[0];
+
+        if (use_arena) {
+            ult_arena_reset();
+        } else {
+            block_signals();
+            for (int i = 0; i < ALLOCS_PER_REQUEST; i++) {
+                free(objects[i]);
+            }
+            unblock_signals();
+        }
+    }
+    return NULL;
+}
+
+double run(bool arena) {
+    use_arena = arena;
+    tid_t threads[NUM_THREADS];
+    uint64_t start = now_ns();
+    for (long i = 0; i < NUM_THREADS; i++) {
+        ult_create(&threads[i], serve, (void*)(i + 1));
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ult_join(threads[i], NULL);
+    }
+    return (double)(now_ns() - start) / ((double)NUM_THREADS * REQUESTS * ALLOCS_PER_REQUEST);
+}
+
+int main() {
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    double with_malloc = run(false);
+    double with_arena = run(true);
+
+    size_t mapped, cached;
+    ult_arena_get_usage(&mapped, &cached);
+    printf("%d threads, %d requests of %d allocations each\n", NUM_THREADS, REQUESTS, ALLOCS_PER_REQUEST);
+    printf("malloc/free with preemption disabled: %6.1f ns per allocation\n", with_malloc);
+    printf("ult_arena_alloc/reset:                %6.1f ns per allocation\n", with_arena);
+    printf("arena chunks: %zu mapped, %zu cached after the threads exited\n", mapped, cached);
+    return EXIT_SUCCESS;
+}
@@ -63,11 +63,13 @@ int main() {
     }
 
     tid_t worker_threads[NUM_WORKERS];
+    void* worker_args[NUM_WORKERS];
     for (long i = 0; i < NUM_WORKERS; i++) {
-        if (ult_create(&worker_threads[i], worker, (void*)i) != EXIT_SUCCESS) {
-            printf("Failed to create worker thread %ld\n", i);
-            return EXIT_FAILURE;
-        }
+        worker_args[i] = (void*)i;
+    }
+    if (ult_create_many(NUM_WORKERS, worker, worker_args, worker_threads) != EXIT_SUCCESS) {
+        printf("Failed to create worker threads\n");
+        return EXIT_FAILURE;
     }
 
     tid_t coordinator_thread;
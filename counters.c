@@ -0,0 +1,128 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/perf.h"
+#include "lib/utils.h"
+
+#define CHASE_ENTRIES (4 * 1024 * 1024)   // 32MB, well past the LLC
+#define STEPS (4 * 1000 * 1000)
+#define SWITCHES 200000
+
+size_t* chase;
+unsigned char* noise;
+volatile uint64_t sink;
+ult_perf_stats_t stats[3];
+const char* names[3] = {"compute", "pointer chase", "random branches"};
+
+void record(int slot) {
+    ult_perf_get(ult_self(), &stats[slot]);
+}
+
+void* compute(void* arg) {
+    uint64_t x = 1;
+    for (long i = 0; i < STEPS * 4L; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    sink = x;
+    record(0);
+    return NULL;
+}
+
+void* pointer_chase(void* arg) {
+    size_t at = 0;
+    for (long i = 0; i < STEPS; i++) {
+        at = chase[at];
+    }
+    sink = at;
+    record(1);
+    return NULL;
+}
+
+void* random_branches(void* arg) {
+    uint64_t taken = 0;
+    for (long i = 0; i < STEPS; i++) {
+        if (noise[i] & 1) {
+            taken += i;
+        } else {
+            taken ^= i;
+        }
+    }
+    sink = taken;
+    record(2);
+    return NULL;
+}
+
+void* ping(void* arg) {
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        ult_yield();
+    }
+    return NULL;
+}
+
+// average cost of a switch between two yielding threads
+double switch_cost_ns() {
+    tid_t a, b;
+    uint64_t start = now_ns();
+    ult_create(&a, ping, NULL);
+    ult_create(&b, ping, NULL);
+    ult_join(a, NULL);
+    ult_join(b, NULL);
+    return (double)(now_ns() - start) / SWITCHES;
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    double plain = switch_cost_ns();
+
+    if (ult_perf_enable() != EXIT_SUCCESS) {
+        printf("Hardware counters unavailable (%s), switch costs %.0f ns\n", strerror(errno), plain);
+        return EXIT_SUCCESS;
+    }
+    double counted = switch_cost_ns();
+
+    // one random cycle through the whole array (Sattolo's shuffle)
+    chase = malloc(CHASE_ENTRIES * sizeof(size_t));
+    noise = malloc(STEPS);
+    for (size_t i = 0; i < CHASE_ENTRIES; i++) {
+        chase[i] = i;
+    }
+    for (size_t i = CHASE_ENTRIES - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % i;
+        size_t tmp = chase[i];
+        chase[i] = chase[j];
+        chase[j] = tmp;
+    }
+    for (long i = 0; i < STEPS; i++) {
+        noise[i] = rand();
+    }
+
+    void* (*routines[3])(void*) = {compute, pointer_chase, random_branches};
+    tid_t threads[3];
+    for (int i = 0; i < 3; i++) {
+        ult_create(&threads[i], routines[i], NULL);
+    }
+    for (int i = 0; i < 3; i++) {
+        ult_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        uint64_t* c = stats[i].counts;
+        double kinst = c[ULT_PERF_INSTRUCTIONS] / 1000.0;
+        printf("%-16s cycles %12lu  ipc %5.2f  llc-miss/kinst %7.2f  branch-miss/kinst %7.2f\n",
+               names[i], c[ULT_PERF_CYCLES],
+               c[ULT_PERF_CYCLES] ? (double)c[ULT_PERF_INSTRUCTIONS] / c[ULT_PERF_CYCLES] : 0.0,
+               kinst > 0 ? c[ULT_PERF_LLC_MISSES] / kinst : 0.0,
+               kinst > 0 ? c[ULT_PERF_BRANCH_MISSES] / kinst : 0.0);
+    }
+    printf("Switch cost: %.0f ns without counters, %.0f ns with counters\n", plain, counted);
+
+    free(chase);
+    free(noise);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/sched.h"
+#include "lib/utils.h"
+
+#define NUM_HOGS 3
+#define NUM_REQUESTS 200
+#define ARRIVAL_US 3000      // a request arrives every 3ms
+#define DEADLINE_US 2000     // and must be answered within 2ms
+#define WORK_US 300
+
+volatile bool stop = false;
+uint64_t latencies[NUM_REQUESTS];
+
+void* batch_job(void* arg) {
+    volatile long work = 0;
+    while (!stop) {
+        work++;
+    }
+    return NULL;
+}
+
+void spin_for(uint64_t ns) {
+    uint64_t end = now_ns() + ns;
+    while (now_ns() < end) {
+    }
+}
+
+void* server(void* arg) {
+    tid_t self = ult_self();
+    for (int i = 0; i < NUM_REQUESTS; i++) {
+        // the next request arrives after ARRIVAL_US and is due DEADLINE_US later,
+        // so the deadline is already known while we sleep until it arrives
+        uint64_t arrival = now_ns() + ARRIVAL_US * 1000ULL;
+        ult_set_deadline(self, ARRIVAL_US + DEADLINE_US);
+        ult_sleep(ARRIVAL_US);
+
+        spin_for(WORK_US * 1000ULL);
+        latencies[i] = now_ns() - arrival;
+    }
+    ult_set_deadline(self, 0);
+    stop = true;
+    return NULL;
+}
+
+int compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    ult_config_t config = {.quantum = 1000, .policy = &ult_sched_rr};
+    if (argc > 1 && strcmp(argv[1], "edf") == 0) {
+        config.policy = &ult_sched_edf;
+    }
+
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    tid_t jobs[NUM_HOGS];
+    for (int i = 0; i < NUM_HOGS; i++) {
+        if (ult_create(&jobs[i], batch_job, NULL) != EXIT_SUCCESS) {
+            printf("Failed to create batch job %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    tid_t server_thread;
+    if (ult_create(&server_thread, server, NULL) != EXIT_SUCCESS) {
+        printf("Failed to create server\n");
+        return EXIT_FAILURE;
+    }
+
+    ult_join(server_thread, NULL);
+    for (int i = 0; i < NUM_HOGS; i++) {
+        ult_join(jobs[i], NULL);
+    }
+
+    qsort(latencies, NUM_REQUESTS, sizeof(uint64_t), compare);
+    printf("Policy %s: response p50 %.2f ms, p99 %.2f ms, deadline %.2f ms, misses %lu/%d\n",
+           config.policy->name, latencies[NUM_REQUESTS / 2] / 1e6,
+           latencies[NUM_REQUESTS * 99 / 100] / 1e6, DEADLINE_US / 1e3,
+           ult_get_total_deadline_misses(), NUM_REQUESTS);
+    return EXIT_SUCCESS;
+}
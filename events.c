@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/cond.h"
+#include "lib/waitany.h"
+#include "lib/utils.h"
+
+#define NUM_MESSAGES 300
+#define NUM_JOBS 100
+#define JOB_NS 20000
+#define PRINTER_NS 100000
+#define TIMEOUT_US 2000
+
+// an event loop reacting to three kinds of events: messages posted on a queue
+// (a condition variable), background jobs finishing (thread exits), and a
+// shared printer becoming free (a mutex) to flush the results of those jobs.
+// With ult_wait_any the dispatcher waits for all of them at once. With
+// `helpers` every job and every flush gets a helper thread that turns it into
+// a message, the only way to wait for more than one object without it
+tid_t queue_lock;
+cid_t queue_cv;
+tid_t printer;
+long queued = 0;
+long exited = 0;          // helpers: jobs joined, not seen by the dispatcher yet
+long flushes_done = 0;    // helpers: flushes finished, not seen by the dispatcher yet
+long printed = 0;
+long helpers_created = 0;
+volatile bool stop = false;
+
+static void spin(long ns) {
+    uint64_t until = now_ns() + ns;
+    while (now_ns() < until) {
+    }
+}
+
+void* producer(void* arg) {
+    for (int i = 0; i < NUM_MESSAGES; i++) {
+        ult_mutex_lock(queue_lock);
+        queued++;
+        ult_cond_signal(queue_cv);
+        ult_mutex_unlock(queue_lock);
+        ult_yield();
+    }
+    return NULL;
+}
+
+void* job(void* arg) {
+    spin(JOB_NS);
+    return arg;
+}
+
+// holds the printer most of the time, so flushes have to wait for it
+void* printer_owner(void* arg) {
+    while (!stop) {
+        ult_mutex_lock(printer);
+        spin(PRINTER_NS);
+        ult_mutex_unlock(printer);
+        ult_yield();
+    }
+    return NULL;
+}
+
+static void post(long* counter) {
+    ult_mutex_lock(queue_lock);
+    (*counter)++;
+    ult_cond_signal(queue_cv);
+    ult_mutex_unlock(queue_lock);
+}
+
+void* job_helper(void* arg) {
+    ult_join((tid_t)arg, NULL);
+    post(&exited);
+    return NULL;
+}
+
+void* flush_helper(void* arg) {
+    ult_mutex_lock(printer);
+    printed += (long)arg;
+    ult_mutex_unlock(printer);
+    post(&flushes_done);
+    return NULL;
+}
+
+static tid_t start_job(long n, bool helpers) {
+    tid_t tid;
+    ult_create(&tid, job, (void*)n);
+    if (helpers) {
+        tid_t helper;
+        ult_create(&helper, job_helper, (void*)tid);
+        ult_detach(helper);
+        helpers_created++;
+    }
+    return tid;
+}
+
+// returns the number of timeouts
+static long dispatch_wait_any() {
+    long handled = 0, jobs_done = 0, unflushed = 0, timeouts = 0;
+    long started = 1;
+    tid_t running_job = start_job(0, false);
+
+    ult_mutex_lock(queue_lock);
+    while (handled < NUM_MESSAGES || jobs_done < NUM_JOBS || unflushed > 0) {
+        if (queued > 0) {
+            queued--;
+            handled++;
+            continue;
+        }
+
+        ult_wait_obj_t objs[3];
+        size_t n = 0;
+        if (handled < NUM_MESSAGES) {
+            objs[n++] = (ult_wait_obj_t){.kind = ULT_WAIT_COND, .id = queue_cv, .mutex = queue_lock};
+        }
+        if (jobs_done < started) {
+            objs[n++] = (ult_wait_obj_t){.kind = ULT_WAIT_THREAD, .id = running_job};
+        }
+        if (unflushed > 0) {
+            objs[n++] = (ult_wait_obj_t){.kind = ULT_WAIT_MUTEX, .id = printer};
+        }
+
+        size_t index;
+        if (ult_wait_any(objs, n, TIMEOUT_US, &index) != EXIT_SUCCESS) {
+            timeouts++;
+            continue;
+        }
+        switch (objs[index].kind) {
+        case ULT_WAIT_COND:
+            break;
+        case ULT_WAIT_THREAD:
+            jobs_done++;
+            unflushed++;
+            if (started < NUM_JOBS) {
+                running_job = start_job(started++, false);
+            }
+            break;
+        case ULT_WAIT_MUTEX:
+            printed += unflushed;
+            unflushed = 0;
+            ult_mutex_unlock(printer);
+            break;
+        }
+    }
+    ult_mutex_unlock(queue_lock);
+    return timeouts;
+}
+
+static void dispatch_helpers() {
+    long handled = 0, jobs_done = 0, unflushed = 0;
+    long started = 1;
+    bool flushing = false;
+    start_job(0, true);
+
+    ult_mutex_lock(queue_lock);
+    while (handled < NUM_MESSAGES || jobs_done < NUM_JOBS || unflushed > 0 || flushing) {
+        if (queued > 0) {
+            queued--;
+            handled++;
+        } else if (exited > 0) {
+            exited--;
+            jobs_done++;
+            unflushed++;
+            if (started < NUM_JOBS) {
+                start_job(started++, true);
+            }
+        } else if (flushes_done > 0) {
+            flushes_done--;
+            flushing = false;
+        } else if (unflushed > 0 && !flushing) {
+            tid_t helper;
+            ult_create(&helper, flush_helper, (void*)unflushed);
+            ult_detach(helper);
+            helpers_created++;
+            unflushed = 0;
+            flushing = true;
+        } else {
+            ult_cond_wait(queue_cv, queue_lock);
+        }
+    }
+    ult_mutex_unlock(queue_lock);
+}
+
+int main(int argc, char* argv[]) {
+    bool helpers = argc > 1 && strcmp(argv[1], "helpers") == 0;
+
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    if (ult_mutex_init(&queue_lock) != EXIT_SUCCESS ||
+        ult_mutex_init(&printer) != EXIT_SUCCESS ||
+        ult_cond_init(&queue_cv) != EXIT_SUCCESS) {
+        printf("Failed to initialize synchronization primitives\n");
+        return EXIT_FAILURE;
+    }
+
+    tid_t producer_thread, printer_thread;
+    ult_create(&printer_thread, printer_owner, NULL);
+    ult_create(&producer_thread, producer, NULL);
+
+    long start = now_ns();
+    long timeouts = 0;
+    if (helpers) {
+        dispatch_helpers();
+    } else {
+        timeouts = dispatch_wait_any();
+    }
+    long elapsed = now_ns() - start;
+
+    stop = true;
+    ult_join(producer_thread, NULL);
+    ult_join(printer_thread, NULL);
+
+    printf("\n%d messages, %d jobs, %ld results printed, %s\n", NUM_MESSAGES, NUM_JOBS, printed,
+           helpers ? "helper threads" : "ult_wait_any");
+    printf("helper threads: %ld\n", helpers_created);
+    printf("queue wakeups:  %lu\n", ult_cond_get_wakeups(queue_cv));
+    if (!helpers) {
+        printf("timeouts:       %ld\n", timeouts);
+    }
+    printf("total:          %.1f ms\n", elapsed / 1e6);
+    return printed == NUM_JOBS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/sched.h"
+#include "lib/utils.h"
+
+#define NUM_HOGS 4
+#define NUM_WAKEUPS 50
+#define SLEEP_US 2000
+
+volatile bool stop = false;
+long progress[NUM_HOGS];
+uint64_t total_delay = 0;
+uint64_t worst_delay = 0;
+
+// batch work: never blocks, only preempted
+void* hog(void* arg) {
+    long id = (long)arg;
+    while (!stop) {
+        progress[id]++;
+    }
+    return NULL;
+}
+
+// interactive work: runs for a moment, then sleeps
+void* interactive(void* arg) {
+    for (int i = 0; i < NUM_WAKEUPS; i++) {
+        uint64_t wanted = now_ns() + SLEEP_US * 1000ULL;
+        ult_sleep(SLEEP_US);
+        uint64_t delay = now_ns() - wanted;
+        total_delay += delay;
+        if (delay > worst_delay) {
+            worst_delay = delay;
+        }
+    }
+    stop = true;
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    ult_config_t config = {.quantum = 5000, .policy = &ult_sched_rr};
+    if (argc > 1 && strcmp(argv[1], "fair") == 0) {
+        config.policy = &ult_sched_fair;
+    }
+
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    tid_t hogs[NUM_HOGS];
+    for (long i = 0; i < NUM_HOGS; i++) {
+        if (ult_create(&hogs[i], hog, (void*)i) != EXIT_SUCCESS) {
+            printf("Failed to create hog %ld\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    tid_t waker;
+    if (ult_create(&waker, interactive, NULL) != EXIT_SUCCESS) {
+        printf("Failed to create interactive thread\n");
+        return EXIT_FAILURE;
+    }
+
+    ult_join(waker, NULL);
+    for (int i = 0; i < NUM_HOGS; i++) {
+        ult_join(hogs[i], NULL);
+    }
+
+    printf("Policy %s: interactive wakeup delay average %.2f ms, worst %.2f ms\n",
+           config.policy->name, total_delay / 1e6 / NUM_WAKEUPS, worst_delay / 1e6);
+    for (int i = 0; i < NUM_HOGS; i++) {
+        printf("Hog %d progress: %ld\n", i, progress[i]);
+    }
+    return EXIT_SUCCESS;
+}
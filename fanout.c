@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/utils.h"
+
+// build with -DMAX_THREADS_COUNT=N to change the size of the thread table
+#define NUM_WORKERS (MAX_THREADS_COUNT - 10)
+
+tid_t* threads;
+void** args;
+bool many = false;
+
+void* worker(void* arg) {
+    return (void*)((long)arg * 2);
+}
+
+// time to create every worker, then joins them all
+uint64_t fan_out() {
+    uint64_t start = now_ns();
+    if (many) {
+        if (ult_create_many(NUM_WORKERS, worker, args, threads) != EXIT_SUCCESS) {
+            printf("Failed to create %d threads\n", NUM_WORKERS);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        for (int i = 0; i < NUM_WORKERS; i++) {
+            if (ult_create(&threads[i], worker, args[i]) != EXIT_SUCCESS) {
+                printf("Failed to create thread %d\n", i);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    uint64_t created = now_ns() - start;
+
+    for (long i = 0; i < NUM_WORKERS; i++) {
+        void* retval;
+        ult_join(threads[i], &retval);
+        if ((long)retval != i * 2) {
+            printf("Thread %ld returned %ld\n", i, (long)retval);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return created;
+}
+
+int main(int argc, char* argv[]) {
+    many = argc > 1 && strcmp(argv[1], "many") == 0;
+
+    // the longest timeslice, so the new workers rarely run while their creation is timed
+    if (ult_init(999999) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    threads = malloc(NUM_WORKERS * sizeof(tid_t));
+    args = malloc(NUM_WORKERS * sizeof(void*));
+    for (long i = 0; i < NUM_WORKERS; i++) {
+        args[i] = (void*)i;
+    }
+
+    // the first round faults in the thread table and the stacks, the second
+    // one reuses the slots the first one left
+    uint64_t cold = fan_out();
+    uint64_t warm = fan_out();
+
+    printf("%d workers through %s: %.1f ms to create on fresh memory, %.1f ms on reused slots (%.0f ns each)\n",
+           NUM_WORKERS, many ? "ult_create_many" : "ult_create", cold / 1e6, warm / 1e6,
+           (double)warm / NUM_WORKERS);
+    free(args);
+    free(threads);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/group.h"
+#include "lib/profile.h"
+#include "lib/utils.h"
+
+#define QUANTUM_US 1000
+#define RUN_MS 2000
+#define BLOCK_SIZE 4096
+
+volatile uint64_t sink;
+
+// "ingest" group: hashing dominates, parsing is a quarter of it
+
+uint64_t hash_block(const unsigned char* block) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            h = (h ^ block[i]) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+uint64_t parse_block(const unsigned char* block) {
+    uint64_t fields = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        fields += block[i] == ',';
+    }
+    return fields;
+}
+
+void* ingest(void* arg) {
+    unsigned char block[BLOCK_SIZE];
+    memset(block, ',', sizeof(block));
+    uint64_t stop = now_ns() + RUN_MS * 1000000ULL;
+    while (now_ns() < stop) {
+        sink = hash_block(block) + parse_block(block);
+    }
+    return NULL;
+}
+
+// "report" group: one thread sorting, mostly inside qsort
+
+int compare_longs(const void* a, const void* b) {
+    long x = *(const long*)a;
+    long y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+void* report(void* arg) {
+    long* values = malloc(20000 * sizeof(long));
+    uint64_t stop = now_ns() + RUN_MS * 1000000ULL;
+    while (now_ns() < stop) {
+        for (int i = 0; i < 20000; i++) {
+            values[i] = (i * 7919L) % 20000;
+        }
+        qsort(values, 20000, sizeof(long), compare_longs);
+    }
+    free(values);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    // "merged", "group" (default) or "thread"
+    ult_profile_split_t split = ULT_PROFILE_BY_GROUP;
+    if (argc > 1 && strcmp(argv[1], "merged") == 0) {
+        split = ULT_PROFILE_MERGED;
+    } else if (argc > 1 && strcmp(argv[1], "thread") == 0) {
+        split = ULT_PROFILE_BY_THREAD;
+    }
+
+    if (ult_init(QUANTUM_US) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    // every tick for RUN_MS at a 1ms quantum, with room to spare
+    if (ult_profile_enable(1, 4 * RUN_MS) != EXIT_SUCCESS) {
+        printf("Failed to start the profiler\n");
+        return EXIT_FAILURE;
+    }
+
+    grpid_t ingest_group, report_group;
+    ult_group_create(&ingest_group, ULT_GROUP_DEFAULT_WEIGHT);
+    ult_group_create(&report_group, ULT_GROUP_DEFAULT_WEIGHT);
+
+    tid_t threads[3];
+    ult_create_in_group(&threads[0], ingest_group, ingest, NULL);
+    ult_create_in_group(&threads[1], ingest_group, ingest, NULL);
+    ult_create_in_group(&threads[2], report_group, report, NULL);
+    for (int i = 0; i < 3; i++) {
+        ult_join(threads[i], NULL);
+    }
+    ult_profile_disable();
+
+    size_t dropped;
+    size_t taken = ult_profile_get_samples(&dropped);
+    fprintf(stderr, "%zu samples (%zu dropped), folded stacks on stdout, e.g. bin/flame | flamegraph.pl > flame.svg\n",
+            taken, dropped);
+    ult_profile_dump(stdout, split);
+    return EXIT_SUCCESS;
+}
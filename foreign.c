@@ -0,0 +1,87 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "lib/ult.h"
+#include "lib/inbox.h"
+#include "lib/utils.h"
+
+#define NUM_HANDOFFS 1000
+
+tid_t receiver;
+volatile uint64_t sent_at = 0;
+volatile bool stop = false;
+uint64_t total_latency = 0;
+uint64_t worst_latency = 0;
+long metrics_seen = 0;
+
+void record_metric(void* arg) {
+    metrics_seen += (long)arg;
+}
+
+// an ordinary pthread, like a metrics exporter or an I/O library thread
+void* exporter(void* arg) {
+    ult_foreign_thread_init();
+
+    for (int i = 0; i < NUM_HANDOFFS; i++) {
+        usleep(200);
+        sent_at = now_ns();
+        ult_wake_from_foreign(receiver);
+        ult_post(record_metric, (void*)1L);
+    }
+    stop = true;
+    ult_wake_from_foreign(receiver);
+    return NULL;
+}
+
+int received = 0;
+
+void* receive(void* arg) {
+    while (!stop) {
+        ult_inbox_wait();
+        uint64_t latency = now_ns() - sent_at;
+        if (!stop) {
+            total_latency += latency;
+            if (latency > worst_latency) {
+                worst_latency = latency;
+            }
+            received++;
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    if (ult_inbox_init() != EXIT_SUCCESS) {
+        perror("Failed to initialize the foreign inbox");
+        return EXIT_FAILURE;
+    }
+
+    if (ult_create(&receiver, receive, NULL) != EXIT_SUCCESS) {
+        printf("Failed to create receiver\n");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t thread;
+    if (ult_foreign_create(&thread, exporter, NULL) != EXIT_SUCCESS) {
+        perror("Failed to create exporter thread");
+        return EXIT_FAILURE;
+    }
+
+    // main blocks too, so the runtime spends its idle time parked on the eventfd
+    ult_join(receiver, NULL);
+
+    pthread_join(thread, NULL);
+    while (metrics_seen < NUM_HANDOFFS) {
+        ult_yield();
+    }
+    printf("Receiver: %d wakeups, average handoff %.1f us, worst %.1f us\n",
+           received, total_latency / 1e3 / (received ? received : 1), worst_latency / 1e3);
+    printf("Main: %ld metrics posted from the exporter ran on the ULT side\n", metrics_seen);
+    return EXIT_SUCCESS;
+}
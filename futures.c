@@ -0,0 +1,68 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/future.h"
+#include "lib/utils.h"
+
+#define NUM_REQUESTS 6
+
+// pretend to serve a request: the cost grows with the request id
+void* handle_request(void* arg) {
+    long id = (long)arg;
+    long sum = 0;
+    for (long step = 0; step < (id + 1) * 5; step++) {
+        sum += step;
+        ult_yield();
+    }
+    printf("Request %ld: done\n", id);
+    return (void*)(id * 1000 + sum);
+}
+
+void* slow_request(void* arg) {
+    for (int i = 0; i < 5; i++) {
+        ms_sleep(100);
+        ult_yield();
+    }
+    return (void*)42L;
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    fid_t requests[NUM_REQUESTS];
+    for (long i = 0; i < NUM_REQUESTS; i++) {
+        if (ult_async(&requests[i], handle_request, (void*)(NUM_REQUESTS - 1 - i)) != EXIT_SUCCESS) {
+            printf("Failed to start request %ld\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t first;
+    ult_when_any(requests, NUM_REQUESTS, &first);
+    void* value;
+    ult_future_get(requests[first], &value);
+    printf("Main: first answer came from future %zu: %ld\n", first, (long)value);
+
+    // one park for the whole fan-in
+    ult_when_all(requests, NUM_REQUESTS);
+    for (int i = 0; i < NUM_REQUESTS; i++) {
+        ult_future_get(requests[i], &value);
+        printf("Main: future %d -> %ld\n", i, (long)value);
+    }
+
+    fid_t slow;
+    ult_async(&slow, slow_request, NULL);
+    if (ult_future_wait_for(slow, 50000, &value) != EXIT_SUCCESS) {
+        printf("Main: slow request not ready after 50ms (%s)\n", strerror(errno));
+    }
+    ult_future_get(slow, &value);
+    printf("Main: slow request finally returned %ld\n", (long)value);
+
+    printf("\nMain: all futures completed\n");
+    return EXIT_SUCCESS;
+}
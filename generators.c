@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/coro.h"
+#include "lib/utils.h"
+
+#define TREE_SIZE 15
+
+typedef struct node {
+    int value;
+    struct node* left;
+    struct node* right;
+} node_t;
+
+node_t nodes[TREE_SIZE];
+
+// build a balanced search tree over nodes[lo..hi]
+node_t* build(int lo, int hi) {
+    if (lo > hi) {
+        return NULL;
+    }
+    int mid = (lo + hi) / 2;
+    nodes[mid].value = mid * 10;
+    nodes[mid].left = build(lo, mid - 1);
+    nodes[mid].right = build(mid + 1, hi);
+    return &nodes[mid];
+}
+
+void walk(node_t* n) {
+    if (n == NULL) {
+        return;
+    }
+    walk(n->left);
+    ult_coro_yield(n);
+    walk(n->right);
+}
+
+// generator: yields every node in order, no queue or condvar involved
+void* in_order(void* arg) {
+    walk((node_t*)arg);
+    return NULL;
+}
+
+void* fibonacci(void* arg) {
+    long limit = (long)arg;
+    long a = 0, b = 1;
+    while (a <= limit) {
+        ult_coro_yield((void*)a);
+        long next = a + b;
+        a = b;
+        b = next;
+    }
+    return NULL;
+}
+
+void* consumer(void* arg) {
+    coid_t walker;
+    if (ult_coro_create(&walker, in_order, build(0, TREE_SIZE - 1)) != EXIT_SUCCESS) {
+        printf("Failed to create tree walker\n");
+        return NULL;
+    }
+
+    printf("Thread %lu walking the tree:", ult_self());
+    void* value;
+    while (ult_coro_resume(walker, &value) == EXIT_SUCCESS && !ult_coro_done(walker)) {
+        printf(" %d", ((node_t*)value)->value);
+    }
+    printf("\n");
+
+    ult_coro_destroy(walker);
+    return NULL;
+}
+
+int main() {
+    if (ult_init(100000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    tid_t walker_thread;
+    if (ult_create(&walker_thread, consumer, NULL) != EXIT_SUCCESS) {
+        printf("Failed to create consumer thread\n");
+        return EXIT_FAILURE;
+    }
+
+    coid_t fib;
+    if (ult_coro_create(&fib, fibonacci, (void*)1000L) != EXIT_SUCCESS) {
+        printf("Failed to create fibonacci generator\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Main generating fibonacci numbers:");
+    void* value;
+    while (ult_coro_resume(fib, &value) == EXIT_SUCCESS && !ult_coro_done(fib)) {
+        printf(" %ld", (long)value);
+    }
+    printf("\n");
+    ult_coro_destroy(fib);
+
+    ult_join(walker_thread, NULL);
+
+    printf("\nMain: generators finished\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/sched.h"
+#include "lib/utils.h"
+
+#define NUM_ROUNDS 5
+#define NUM_MEDIUM 3
+#define CRITICAL_US 5000     // low keeps the inner lock this long
+#define MEDIUM_US 30000      // medium threads burn the CPU this long
+#define RELAY_DELAY_US 500
+#define HIGH_DELAY_US 2000
+
+#define PRIO_LOW 1
+#define PRIO_RELAY 2
+#define PRIO_MEDIUM 5
+#define PRIO_HIGH 10
+
+tid_t inner;   // held by low
+tid_t outer;   // held by relay while it waits for inner
+uint64_t waits[NUM_ROUNDS];
+int round_no = 0;
+
+void spin_for(uint64_t ns) {
+    uint64_t end = now_ns() + ns;
+    while (now_ns() < end) {
+    }
+}
+
+void* low(void* arg) {
+    ult_mutex_lock(inner);
+    spin_for(CRITICAL_US * 1000ULL);
+    ult_mutex_unlock(inner);
+    return NULL;
+}
+
+// waits for low while holding the lock high needs: high -> relay -> low
+void* relay(void* arg) {
+    ult_sleep(RELAY_DELAY_US);
+    ult_mutex_lock(outer);
+    ult_mutex_lock(inner);
+    ult_mutex_unlock(inner);
+    ult_mutex_unlock(outer);
+    return NULL;
+}
+
+void* high(void* arg) {
+    ult_sleep(HIGH_DELAY_US);
+    uint64_t start = now_ns();
+    ult_mutex_lock(outer);
+    waits[round_no] = now_ns() - start;
+    ult_mutex_unlock(outer);
+    return NULL;
+}
+
+void* medium(void* arg) {
+    ult_sleep(HIGH_DELAY_US);
+    spin_for(MEDIUM_US * 1000ULL);
+    return NULL;
+}
+
+tid_t spawn(void* (*routine)(void*), int priority) {
+    tid_t tid;
+    if (ult_create(&tid, routine, NULL) != EXIT_SUCCESS) {
+        printf("Failed to create thread\n");
+        exit(EXIT_FAILURE);
+    }
+    ult_set_priority(tid, priority);
+    return tid;
+}
+
+int main(int argc, char** argv) {
+    ult_mutex_protocol_t protocol = ULT_MUTEX_PRIO_INHERIT;
+    if (argc > 1 && strcmp(argv[1], "none") == 0) {
+        protocol = ULT_MUTEX_PRIO_NONE;
+    }
+
+    ult_config_t config = {.quantum = 1000, .policy = &ult_sched_prio};
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    // main only sets up the rounds, nobody may run before everything is in place
+    ult_set_priority(ult_self(), ULT_PRIO_MAX);
+    ult_mutex_init_protocol(&inner, protocol);
+    ult_mutex_init_protocol(&outer, protocol);
+
+    for (round_no = 0; round_no < NUM_ROUNDS; round_no++) {
+        tid_t threads[NUM_MEDIUM + 3];
+        threads[0] = spawn(low, PRIO_LOW);
+        threads[1] = spawn(relay, PRIO_RELAY);
+        threads[2] = spawn(high, PRIO_HIGH);
+        for (int i = 0; i < NUM_MEDIUM; i++) {
+            threads[3 + i] = spawn(medium, PRIO_MEDIUM);
+        }
+
+        for (int i = 0; i < NUM_MEDIUM + 3; i++) {
+            ult_join(threads[i], NULL);
+        }
+    }
+
+    uint64_t worst = 0;
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+        printf("Round %d: high waited %.2f ms\n", i, waits[i] / 1e6);
+        if (waits[i] > worst) {
+            worst = waits[i];
+        }
+    }
+    printf("Protocol %s: worst wait %.2f ms, critical section %.2f ms, medium work %.2f ms\n",
+           protocol == ULT_MUTEX_PRIO_INHERIT ? "inherit" : "none", worst / 1e6,
+           CRITICAL_US / 1e3, MEDIUM_US / 1e3);
+    return EXIT_SUCCESS;
+}
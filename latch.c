@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/utils.h"
+
+#define NUM_WORKERS 4
+#define NUM_WAITERS 3
+
+// a countdown latch written outside the library: its own state behind a mutex,
+// and ult_park/ult_unpark to block. A count down between a waiter's unlock and
+// its park leaves a permit, so the park returns instead of missing the wakeup
+typedef struct {
+    tid_t lock;
+    long count;
+    tid_t waiters[NUM_WAITERS + 1];
+    size_t waiting;
+} latch_t;
+
+latch_t latch;
+int results[NUM_WAITERS];
+uint64_t started;
+
+int latch_init(latch_t* l, long count) {
+    l->count = count;
+    l->waiting = 0;
+    return ult_mutex_init(&l->lock);
+}
+
+void latch_count_down(latch_t* l) {
+    tid_t wake[NUM_WAITERS + 1];
+    size_t n = 0;
+
+    ult_mutex_lock(l->lock);
+    if (l->count > 0 && --l->count == 0) {
+        for (n = 0; n < l->waiting; n++) {
+            wake[n] = l->waiters[n];
+        }
+        l->waiting = 0;
+    }
+    ult_mutex_unlock(l->lock);
+
+    // outside the lock: a woken waiter does not block on it right away
+    for (size_t i = 0; i < n; i++) {
+        ult_unpark(wake[i]);
+    }
+}
+
+// 0 once the count reached zero, ETIMEDOUT if deadline_ns (0 for none) passed first
+int latch_await(latch_t* l, uint64_t deadline_ns) {
+    tid_t self = ult_self();
+
+    ult_mutex_lock(l->lock);
+    if (l->count > 0) {
+        l->waiters[l->waiting++] = self;
+    }
+    while (l->count > 0) {
+        ult_mutex_unlock(l->lock);
+        int status = ult_park_until(l, deadline_ns);
+        ult_mutex_lock(l->lock);
+
+        if (status != EXIT_SUCCESS && l->count > 0) {
+            for (size_t i = 0; i < l->waiting; i++) {
+                if (l->waiters[i] == self) {
+                    l->waiters[i] = l->waiters[--l->waiting];
+                    break;
+                }
+            }
+            ult_mutex_unlock(l->lock);
+            return ETIMEDOUT;
+        }
+    }
+    ult_mutex_unlock(l->lock);
+    return 0;
+}
+
+void* worker(void* arg) {
+    long id = (long)arg;
+    ult_sleep((id + 1) * 5000);
+    latch_count_down(&latch);
+    return NULL;
+}
+
+void* waiter(void* arg) {
+    long id = (long)arg;
+    // the last waiter only gives the workers 2ms
+    uint64_t deadline = id == NUM_WAITERS - 1 ? now_ns() + 2000000 : 0;
+    results[id] = latch_await(&latch, deadline);
+    return NULL;
+}
+
+int main() {
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    // an unpark sent before the park is kept
+    ult_unpark(ult_self());
+    ult_park(NULL);
+    printf("park after unpark returned at once\n");
+
+    if (latch_init(&latch, NUM_WORKERS) != EXIT_SUCCESS) {
+        printf("Failed to initialize latch\n");
+        return EXIT_FAILURE;
+    }
+
+    started = now_ns();
+    tid_t workers[NUM_WORKERS];
+    tid_t waiters[NUM_WAITERS];
+    for (long i = 0; i < NUM_WAITERS; i++) {
+        ult_create(&waiters[i], waiter, (void*)i);
+    }
+    for (long i = 0; i < NUM_WORKERS; i++) {
+        ult_create(&workers[i], worker, (void*)i);
+    }
+
+    latch_await(&latch, 0);
+    printf("main: latch opened after %.1f ms\n", (now_ns() - started) / 1e6);
+
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        ult_join(workers[i], NULL);
+    }
+    for (int i = 0; i < NUM_WAITERS; i++) {
+        ult_join(waiters[i], NULL);
+        printf("waiter %d: %s\n", i, results[i] == 0 ? "opened" : "timed out");
+    }
+    return EXIT_SUCCESS;
+}
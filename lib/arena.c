@@ -0,0 +1,126 @@
+#include "arena.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define ALIGNMENT 16
+
+typedef struct chunk {
+    struct chunk *next;
+    size_t size;     // bytes mapped, header included
+    size_t used;     // bytes handed out, header included
+} chunk_t;
+
+#define HEADER_SIZE ((sizeof(chunk_t) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+// only the owning ULT touches its list, ult_exit runs on that ULT too
+static chunk_t *chunks[MAX_THREADS_COUNT];   // current chunk first
+static chunk_t *free_chunks = NULL;          // shared, SIGALRM blocked
+static size_t cached_count = 0;
+static size_t mapped_count = 0;
+
+static chunk_t *map_chunk(size_t size) {
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == memory) {
+        return NULL;
+    }
+    chunk_t *c = memory;
+    c->size = size;
+    mapped_count++;
+    return c;
+}
+
+// a chunk with at least size bytes, from the free list if it can, signals must be blocked
+static chunk_t *get_chunk(size_t size) {
+    if (size <= ULT_ARENA_CHUNK_SIZE && NULL != free_chunks) {
+        chunk_t *c = free_chunks;
+        free_chunks = c->next;
+        cached_count--;
+        return c;
+    }
+    // oversized requests get a chunk of their own
+    size_t bytes = size <= ULT_ARENA_CHUNK_SIZE ? ULT_ARENA_CHUNK_SIZE : size;
+    return map_chunk(bytes);
+}
+
+// signals must be blocked
+static void put_chunk(chunk_t *c) {
+    if (ULT_ARENA_CHUNK_SIZE != c->size || cached_count == ULT_ARENA_MAX_CACHED) {
+        mapped_count--;
+        munmap(c, c->size);
+        return;
+    }
+    c->next = free_chunks;
+    free_chunks = c;
+    cached_count++;
+}
+
+void *ult_arena_alloc(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    size_t self = ULT_TID_SLOT(ult_self());
+
+    // fast path: bump inside the current chunk, nobody else touches it
+    chunk_t *c = chunks[self];
+    if (NULL != c && c->size - c->used >= size) {
+        void *p = (char *)c + c->used;
+        c->used += size;
+        return p;
+    }
+
+    block_signals();
+    c = get_chunk(HEADER_SIZE + size);
+    unblock_signals();
+    if (NULL == c) {
+        return NULL;
+    }
+
+    c->used = HEADER_SIZE + size;
+    c->next = chunks[self];
+    chunks[self] = c;
+    return (char *)c + HEADER_SIZE;
+}
+
+void ult_arena_reset(void) {
+    size_t self = ULT_TID_SLOT(ult_self());
+    chunk_t *keep = chunks[self];
+    if (NULL == keep) {
+        return;
+    }
+
+    block_signals();
+    chunk_t *c = keep->next;
+    while (NULL != c) {
+        chunk_t *next = c->next;
+        put_chunk(c);
+        c = next;
+    }
+
+    // keep one chunk, so a thread resetting between requests stays off the free list
+    if (ULT_ARENA_CHUNK_SIZE == keep->size) {
+        keep->next = NULL;
+        keep->used = HEADER_SIZE;
+    } else {
+        put_chunk(keep);
+        keep = NULL;
+    }
+    chunks[self] = keep;
+    unblock_signals();
+}
+
+void ult_arena_release(tid_t tid) {
+    chunk_t *c = chunks[ULT_TID_SLOT(tid)];
+    while (NULL != c) {
+        chunk_t *next = c->next;
+        put_chunk(c);
+        c = next;
+    }
+    chunks[ULT_TID_SLOT(tid)] = NULL;
+}
+
+void ult_arena_get_usage(size_t *mapped, size_t *cached) {
+    block_signals();
+    *mapped = mapped_count;
+    *cached = cached_count;
+    unblock_signals();
+}
@@ -0,0 +1,24 @@
+#ifndef ULT_ARENA_H
+#define ULT_ARENA_H
+
+#include "ult.h"
+
+// Per-ULT region allocator (unrelated to the huge page thread arena). Each ULT
+// bumps a pointer through its own chunks, so an allocation is a few
+// instructions, never enters malloc and is safe to preempt. Nothing is freed
+// one by one: ult_arena_reset() drops everything the calling ULT allocated, and
+// ult_exit() does it for good. Chunks go back to a free list shared by all ULTs
+// and are mmap'ed only when that list is empty. Memory from ult_arena_alloc
+// must not outlive its thread, e.g. as the value passed to ult_exit.
+
+#define ULT_ARENA_CHUNK_SIZE (64 * 1024)
+#define ULT_ARENA_MAX_CACHED 256     // free chunks kept for reuse, the rest is unmapped
+
+void *ult_arena_alloc(size_t size);
+void ult_arena_reset(void);
+void ult_arena_get_usage(size_t *mapped, size_t *cached);   // chunks in use or cached, chunks cached
+
+// SIGALRM must be blocked, called by ult_exit
+void ult_arena_release(tid_t tid);
+
+#endif
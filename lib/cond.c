@@ -1,21 +1,38 @@
 #include "cond.h"
 #include "mutex.h"
 #include "utils.h"
+#include "probes.h"
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
 
-static ult_cond_t conditions[MAX_THREADS_COUNT];
+static ult_cond_t conditions[MAX_SYNC_COUNT];
 static size_t cond_count = 0;
 
+// what each thread blocked in ult_cond_wait_pred waits for, NULL for a plain wait
+static ult_cond_pred_t wait_pred[MAX_THREADS_COUNT];
+static void *wait_pred_arg[MAX_THREADS_COUNT];
+static tid_t wait_mutex[MAX_THREADS_COUNT];   // mutex given to the last wait of each thread
+
+// a waiter with a predicate stays parked while the predicate is false. The
+// predicate reads state guarded by the waiter's mutex, so it is only trusted when
+// the signaling thread holds that mutex; otherwise the waiter wakes and rechecks
+static bool should_wake(size_t waiter) {
+    if (NULL == wait_pred[waiter] || ult_mutex_get_holder(wait_mutex[waiter]) != ult_self()) {
+        return true;
+    }
+    return wait_pred[waiter](wait_pred_arg[waiter]);
+}
+
 int ult_cond_init(cid_t *cid) {
-    if (MAX_THREADS_COUNT - 1 == cond_count) {
+    if (MAX_SYNC_COUNT - 1 == cond_count) {
         return EXIT_FAILURE;
     }
 
     ult_cond_t *cv = &conditions[cond_count];
     cv->id = cond_count;
     cv->waiting_count = 0;
+    cv->wakeups = 0;
     memset(cv->waiting_threads, 0, sizeof(bool) * MAX_THREADS_COUNT);
 
     *cid = cond_count;
@@ -49,60 +66,115 @@ int ult_cond_wait(cid_t cid, tid_t mid) {
     }
 
     ult_cond_t *cv = &conditions[cid];
-    tid_t self = ult_self();
-    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(ult_self());
 
-    if (!current) {
+    cv->waiting_count++;
+    cv->waiting_threads[self] = true;
+    wait_mutex[self] = mid;
+    ULT_PROBE_COND_WAIT(cid, mid, ult_self());
+
+    tid_t woken;
+    if (EXIT_SUCCESS != ult_mutex_release(mid, &woken)) {
+        cv->waiting_threads[self] = false;
+        cv->waiting_count--;
         unblock_signals();
-        errno = EINVAL;
         return EXIT_FAILURE;
     }
+    unblock_signals();
 
-    cv->waiting_count++;
-    cv->waiting_threads[self] = true;
-
-    ult_mutex_unlock(mid);
-    current->state = ULT_BLOCKED;
+    // with handoff the thread the release woke runs first
+    if (-1 != woken && ult_handoff_enabled()) {
+        ult_yield_to(woken);
+    }
 
-    // yield control until signaled
+    // park until signaled: signal takes us off the waiting list before unparking,
+    // and a signal sent since the release is kept as the permit
+    block_signals();
+    while (cv->waiting_threads[self]) {
+        unblock_signals();
+        ult_park(cv);
+        block_signals();
+    }
     unblock_signals();
-    ult_yield();
 
     // reacquire mutex after being signaled
-    block_signals();
     ult_mutex_lock(mid);
-
-    unblock_signals();
     return EXIT_SUCCESS;
 }
 
-int ult_cond_signal(cid_t cid) {
-    block_signals();
-    if (cid >= cond_count) {
-        unblock_signals();
+// returns with the mutex held and pred true; signal and broadcast skip this waiter
+// while pred is false instead of waking it just to go back to sleep
+int ult_cond_wait_pred(cid_t cid, tid_t mid, ult_cond_pred_t pred, void *arg) {
+    if (cid >= cond_count || NULL == pred) {
         errno = EINVAL;
         return EXIT_FAILURE;
     }
 
-    ult_cond_t *cv = &conditions[cid];
+    size_t self = ULT_TID_SLOT(ult_self());
+    block_signals();
+    wait_pred[self] = pred;
+    wait_pred_arg[self] = arg;
+    unblock_signals();
 
-    // wake up one waiting thread if any
+    int status = EXIT_SUCCESS;
+    // another thread may take the mutex between our wakeup and our relock
+    while (!pred(arg) && EXIT_SUCCESS == status) {
+        status = ult_cond_wait(cid, mid);
+    }
+
+    block_signals();
+    wait_pred[self] = NULL;
+    unblock_signals();
+    return status;
+}
+
+// take one waiting thread off the list and unpark it, -1 if none
+static tid_t wake_one(ult_cond_t *cv) {
     for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
-        if (cv->waiting_threads[i]) {
+        if (cv->waiting_threads[i] && should_wake(i)) {
             cv->waiting_threads[i] = false;
             cv->waiting_count--;
+            cv->wakeups++;
 
-            ult_t *thread = get_thread_by_id(i);
+            ult_t *thread = get_thread_by_slot(i);
             if (thread != NULL) {
-                printf("Sending single signal from %ld to %ld\n", cid, thread->tid);
+                printf("Sending single signal from %ld to %ld\n", cv->id, thread->tid);
 
-                thread->state = ULT_READY;
+                ult_unpark_thread(thread);
+                return thread->tid;
             }
-            break;
+            return -1;
         }
     }
+    return -1;
+}
+
+int ult_cond_signal(cid_t cid) {
+    block_signals();
+    if (cid >= cond_count) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_cond_t *cv = &conditions[cid];
+    tid_t woken = wake_one(cv);
+
+    ULT_PROBE_COND_SIGNAL(cid, woken);
+    if (-1 == woken || !ult_handoff_enabled()) {
+        unblock_signals();
+        return EXIT_SUCCESS;
+    }
+
+    // the woken thread needs the mutex first: if we hold it, hand over when we release it
+    if (ult_mutex_get_holder(wait_mutex[ULT_TID_SLOT(woken)]) == ult_self()) {
+        ult_mutex_handoff_on_unlock(wait_mutex[ULT_TID_SLOT(woken)], woken);
+        unblock_signals();
+        return EXIT_SUCCESS;
+    }
 
     unblock_signals();
+    ult_yield_to(woken);
     return EXIT_SUCCESS;
 }
 
@@ -116,20 +188,68 @@ int ult_cond_broadcast(cid_t cid) {
     }
 
     ult_cond_t *cv = &conditions[cid];
+    long woken = 0;
 
     for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
-        if (cv->waiting_threads[i]) {
+        if (cv->waiting_threads[i] && should_wake(i)) {
             cv->waiting_threads[i] = false;
             cv->waiting_count--;
+            cv->wakeups++;
+            woken++;
 
-            ult_t *thread = get_thread_by_id(i);
+            ult_t *thread = get_thread_by_slot(i);
             if (thread != NULL) {
-                thread->state = ULT_READY;
+                ult_unpark_thread(thread);
             }
         }
     }
 
+    ULT_PROBE_COND_BROADCAST(cid, woken);
     printf("Sending broadcast signal from %ld\n", cid);
     unblock_signals();
     return EXIT_SUCCESS;
 }
+
+// The three calls below let ult_wait_any wait for a signal among other objects,
+// SIGALRM must be blocked. add_waiter puts the caller on the waiting list; signal
+// and broadcast take it off before unparking it, as for ult_cond_wait
+int ult_cond_add_waiter(cid_t cid, tid_t mid) {
+    if (cid >= cond_count || conditions[cid].id == (cid_t)-1) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_cond_t *cv = &conditions[cid];
+    size_t self = ULT_TID_SLOT(ult_self());
+    if (!cv->waiting_threads[self]) {
+        cv->waiting_count++;
+        cv->waiting_threads[self] = true;
+    }
+    wait_mutex[self] = mid;
+    ULT_PROBE_COND_WAIT(cid, mid, ult_self());
+    return EXIT_SUCCESS;
+}
+
+bool ult_cond_signaled(cid_t cid) {
+    return !conditions[cid].waiting_threads[ULT_TID_SLOT(ult_self())];
+}
+
+// leave the waiting list. A signal that already took the caller off is passed
+// on to the next waiter, so waiting for something else never swallows it
+void ult_cond_remove_waiter(cid_t cid) {
+    ult_cond_t *cv = &conditions[cid];
+    size_t self = ULT_TID_SLOT(ult_self());
+    if (cv->waiting_threads[self]) {
+        cv->waiting_threads[self] = false;
+        cv->waiting_count--;
+    } else {
+        wake_one(cv);
+    }
+}
+
+unsigned long ult_cond_get_wakeups(cid_t cid) {
+    if (cid >= cond_count) {
+        return 0;
+    }
+    return conditions[cid].wakeups;
+}
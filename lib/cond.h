@@ -6,16 +6,26 @@
 
 typedef size_t cid_t;
 
+// runs with SIGALRM blocked, on the waiter or on the signaling thread: it must
+// only read state guarded by the wait's mutex, and never block
+typedef bool (*ult_cond_pred_t)(void *arg);
+
 typedef struct {
     cid_t id;
     size_t waiting_count;
     bool waiting_threads[MAX_THREADS_COUNT];
+    unsigned long wakeups;      // waiters made runnable by signal and broadcast
 } ult_cond_t;
 
 int ult_cond_init(cid_t *cid);
 int ult_cond_destroy(cid_t cid);
 int ult_cond_wait(cid_t cid, tid_t mid);
+int ult_cond_wait_pred(cid_t cid, tid_t mid, ult_cond_pred_t pred, void *arg);
 int ult_cond_signal(cid_t cid);
 int ult_cond_broadcast(cid_t cid);
+unsigned long ult_cond_get_wakeups(cid_t cid);
+int ult_cond_add_waiter(cid_t cid, tid_t mid);
+bool ult_cond_signaled(cid_t cid);
+void ult_cond_remove_waiter(cid_t cid);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "coro.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static ult_coro_t coroutines[MAX_SYNC_COUNT];
+static size_t coro_count = 0;
+
+// coroutine each ULT is currently executing, NULL when it runs its own code
+static ult_coro_t *current_coro[MAX_THREADS_COUNT];
+
+static void coro_entry(void) {
+    block_signals();
+    ult_coro_t *co = current_coro[ULT_TID_SLOT(ult_self())];
+    unblock_signals();
+
+    co->value = co->start_routine(co->arg);
+    co->done = true;
+    // returning switches to co->caller through uc_link
+}
+
+int ult_coro_create(coid_t *coid, void *(*start_routine)(void *), void *arg) {
+    if (MAX_SYNC_COUNT - 1 == coro_count) {
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+    ult_coro_t *co = &coroutines[coro_count];
+    memset(co, 0, sizeof(ult_coro_t));
+    co->id = coro_count;
+    co->start_routine = start_routine;
+    co->arg = arg;
+
+    if (getcontext(&co->context) == -1 ||
+        ult_make_context(&co->context, NULL, &co->caller, coro_entry) != EXIT_SUCCESS) {
+        unblock_signals();
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+
+    *coid = coro_count;
+    coro_count++;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+int ult_coro_resume(coid_t coid, void **value) {
+    block_signals();
+
+    if (coid >= coro_count || coroutines[coid].id == (coid_t)-1) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_coro_t *co = &coroutines[coid];
+    if (co->done || co->running) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    // the coroutine runs as part of this ULT: if it gets preempted the
+    // scheduler saves it in our thread context and brings it back later
+    size_t self = ULT_TID_SLOT(ult_self());
+    co->running = true;
+    co->parent = current_coro[self];
+    current_coro[self] = co;
+    unblock_signals();
+
+    swapcontext(&co->caller, &co->context);
+
+    // back from ult_coro_yield or from the start routine returning
+    block_signals();
+    current_coro[self] = co->parent;
+    co->parent = NULL;
+    co->running = false;
+    if (value != NULL) {
+        *value = co->value;
+    }
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+void ult_coro_yield(void *value) {
+    block_signals();
+    ult_coro_t *co = current_coro[ULT_TID_SLOT(ult_self())];
+    if (co == NULL) {
+        // not inside a coroutine, nothing to yield to
+        unblock_signals();
+        return;
+    }
+    co->value = value;
+    unblock_signals();
+
+    swapcontext(&co->context, &co->caller);
+}
+
+bool ult_coro_done(coid_t coid) {
+    if (coid >= coro_count) {
+        return true;
+    }
+    return coroutines[coid].done;
+}
+
+int ult_coro_destroy(coid_t coid) {
+    if (coid >= coro_count) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_coro_t *co = &coroutines[coid];
+    if (co->running) {
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+    free(co->context.uc_stack.ss_sp);
+    co->context.uc_stack.ss_sp = NULL;
+    co->id = -1;
+    co->done = true;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
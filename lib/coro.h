@@ -0,0 +1,30 @@
+#ifndef ULT_CORO_H
+#define ULT_CORO_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+typedef size_t coid_t;
+
+// An asymmetric coroutine. It runs on its own stack but on behalf of the ULT
+// that resumed it, so resume/yield are plain context switches that never go
+// through the scheduler or the run queue.
+typedef struct ult_coro {
+    coid_t id;
+    bool done;                    // start routine returned
+    bool running;                 // currently resumed by some ULT
+    ucontext_t context;           // coroutine side
+    ucontext_t caller;            // resumer side, uc_link target when the routine returns
+    void *(*start_routine)(void *);
+    void *arg;
+    void *value;                  // last yielded (or returned) value
+    struct ult_coro *parent;      // coroutine the resumer was running before us (nesting)
+} ult_coro_t;
+
+int ult_coro_create(coid_t *coid, void *(*start_routine)(void *), void *arg);
+int ult_coro_resume(coid_t coid, void **value);
+void ult_coro_yield(void *value);
+bool ult_coro_done(coid_t coid);
+int ult_coro_destroy(coid_t coid);
+
+#endif
@@ -0,0 +1,196 @@
+#include "executor.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EXECUTOR_INITIAL_CAPACITY 256
+#define EXECUTOR_BATCH 32   // tasks a worker takes per critical section
+
+// grow the ring buffer so it can hold `extra` more tasks, signals must be blocked
+static int executor_reserve(ult_executor_t *ex, size_t extra) {
+    if (ex->count + extra <= ex->capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    size_t capacity = ex->capacity ? ex->capacity : EXECUTOR_INITIAL_CAPACITY;
+    while (capacity < ex->count + extra) {
+        capacity *= 2;
+    }
+
+    ult_task_t *tasks = malloc(capacity * sizeof(ult_task_t));
+    if (tasks == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    // unwrap the old ring so the pending tasks start at index 0
+    for (size_t i = 0; i < ex->count; i++) {
+        tasks[i] = ex->tasks[(ex->head + i) % ex->capacity];
+    }
+    free(ex->tasks);
+
+    ex->tasks = tasks;
+    ex->capacity = capacity;
+    ex->head = 0;
+    return EXIT_SUCCESS;
+}
+
+static void wake_drainers(ult_executor_t *ex) {
+    for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
+        if (ex->drain_waiters[i]) {
+            ex->drain_waiters[i] = false;
+
+            ult_t *thread = get_thread_by_slot(i);
+            if (thread != NULL) {
+                ult_make_ready(thread);
+            }
+        }
+    }
+}
+
+static void *executor_worker(void *arg) {
+    ult_executor_t *ex = arg;
+    ult_t *current = get_current_thread();
+    ult_task_t batch[EXECUTOR_BATCH];
+
+    block_signals();
+    for (;;) {
+        // park until there is work or we are told to stop
+        while (ex->count == 0 && !ex->shutting_down) {
+            ex->idle[ex->idle_count++] = current->tid;
+            current->state = ULT_BLOCKED;
+            unblock_signals();
+            ult_yield();
+            block_signals();
+        }
+
+        if (ex->count == 0) {
+            break;
+        }
+
+        size_t taken = ex->count < EXECUTOR_BATCH ? ex->count : EXECUTOR_BATCH;
+        for (size_t i = 0; i < taken; i++) {
+            batch[i] = ex->tasks[ex->head];
+            ex->head = (ex->head + 1) % ex->capacity;
+        }
+        ex->count -= taken;
+        ex->in_flight += taken;
+        unblock_signals();
+
+        for (size_t i = 0; i < taken; i++) {
+            batch[i].fn(batch[i].arg);
+        }
+
+        block_signals();
+        ex->in_flight -= taken;
+        if (ex->count == 0 && ex->in_flight == 0) {
+            wake_drainers(ex);
+        }
+    }
+    unblock_signals();
+
+    return NULL;
+}
+
+int ult_executor_init(ult_executor_t *ex, size_t workers) {
+    if (workers == 0 || workers > EXECUTOR_MAX_WORKERS) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    memset(ex, 0, sizeof(ult_executor_t));
+
+    for (size_t i = 0; i < workers; i++) {
+        if (ult_create(&ex->workers[i], executor_worker, ex) != EXIT_SUCCESS) {
+            ult_executor_shutdown(ex);
+            return EXIT_FAILURE;
+        }
+        ex->worker_count++;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int ult_executor_submit(ult_executor_t *ex, ult_task_fn fn, void *arg) {
+    return ult_executor_submit_bulk(ex, fn, &arg, 1);
+}
+
+int ult_executor_submit_bulk(ult_executor_t *ex, ult_task_fn fn, void **args, size_t n) {
+    block_signals();
+
+    if (ex->shutting_down) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    if (executor_reserve(ex, n) != EXIT_SUCCESS) {
+        unblock_signals();
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        ult_task_t *task = &ex->tasks[(ex->head + ex->count) % ex->capacity];
+        task->fn = fn;
+        task->arg = args[i];
+        ex->count++;
+    }
+
+    // wake just enough parked workers for the new batch, all in one go
+    size_t wanted = (n + EXECUTOR_BATCH - 1) / EXECUTOR_BATCH;
+    while (wanted > 0 && ex->idle_count > 0) {
+        ult_t *worker = get_thread_by_id(ex->idle[--ex->idle_count]);
+        if (worker != NULL) {
+            ult_make_ready(worker);
+        }
+        wanted--;
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_executor_drain(ult_executor_t *ex) {
+    block_signals();
+    ult_t *current = get_current_thread();
+
+    while (ex->count > 0 || ex->in_flight > 0) {
+        ex->drain_waiters[ULT_TID_SLOT(current->tid)] = true;
+        current->state = ULT_BLOCKED;
+        unblock_signals();
+        ult_yield();
+        block_signals();
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_executor_shutdown(ult_executor_t *ex) {
+    block_signals();
+    ex->shutting_down = true;
+
+    // workers run what is still queued, then notice the flag and return
+    while (ex->idle_count > 0) {
+        ult_t *worker = get_thread_by_id(ex->idle[--ex->idle_count]);
+        if (worker != NULL) {
+            ult_make_ready(worker);
+        }
+    }
+    unblock_signals();
+
+    for (size_t i = 0; i < ex->worker_count; i++) {
+        ult_join(ex->workers[i], NULL);
+    }
+
+    block_signals();
+    free(ex->tasks);
+    ex->tasks = NULL;
+    ex->capacity = 0;
+    ex->worker_count = 0;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef ULT_EXECUTOR_H
+#define ULT_EXECUTOR_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+#define EXECUTOR_MAX_WORKERS 64
+
+typedef void (*ult_task_fn)(void *);
+
+typedef struct {
+    ult_task_fn fn;
+    void *arg;
+} ult_task_t;
+
+// A fixed set of long-lived worker ULTs pulling tasks from a shared ring buffer.
+typedef struct {
+    size_t worker_count;
+    tid_t workers[EXECUTOR_MAX_WORKERS];
+    tid_t idle[EXECUTOR_MAX_WORKERS];          // parked workers, woken on submit
+    size_t idle_count;
+
+    ult_task_t *tasks;                         // ring buffer of pending tasks
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t in_flight;                          // taken by a worker, not yet finished
+
+    bool shutting_down;
+    bool drain_waiters[MAX_THREADS_COUNT];     // threads blocked in ult_executor_drain
+} ult_executor_t;
+
+int ult_executor_init(ult_executor_t *ex, size_t workers);
+int ult_executor_submit(ult_executor_t *ex, ult_task_fn fn, void *arg);
+int ult_executor_submit_bulk(ult_executor_t *ex, ult_task_fn fn, void **args, size_t n);
+int ult_executor_drain(ult_executor_t *ex);
+int ult_executor_shutdown(ult_executor_t *ex);
+
+#endif
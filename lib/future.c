@@ -0,0 +1,255 @@
+#include "future.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static ult_future_t futures[MAX_SYNC_COUNT];
+static size_t future_count = 0;
+
+// completions each waiting thread still needs before it is woken:
+// 1 for get/wait_for/when_any, the number of unfinished futures for when_all
+static size_t pending_completions[MAX_THREADS_COUNT];
+
+static bool valid_future(fid_t fid) {
+    return fid < future_count && futures[fid].id != (fid_t)-1;
+}
+
+static void add_waiter(ult_future_t *f, size_t self) {
+    if (!f->waiting_threads[self]) {
+        f->waiting_threads[self] = true;
+        f->waiting_count++;
+    }
+}
+
+static void remove_waiter(ult_future_t *f, size_t self) {
+    if (f->waiting_threads[self]) {
+        f->waiting_threads[self] = false;
+        f->waiting_count--;
+    }
+}
+
+static void *future_routine(void *arg) {
+    ult_future_t *f = arg;
+    void *value = f->start_routine(f->arg);
+
+    block_signals();
+    f->value = value;
+    f->done = true;
+
+    // single pass over the waiters, each one is made runnable at most once
+    for (size_t i = 0; i < MAX_THREADS_COUNT && f->waiting_count > 0; i++) {
+        if (f->waiting_threads[i]) {
+            f->waiting_threads[i] = false;
+            f->waiting_count--;
+
+            if (pending_completions[i] > 0 && --pending_completions[i] == 0) {
+                ult_t *thread = get_thread_by_slot(i);
+                if (thread != NULL && thread->state == ULT_BLOCKED) {
+                    ult_make_ready(thread);
+                }
+            }
+        }
+    }
+    unblock_signals();
+
+    return value;
+}
+
+int ult_async(fid_t *fid, void *(*start_routine)(void *), void *arg) {
+    if (MAX_SYNC_COUNT - 1 == future_count) {
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+    ult_future_t *f = &futures[future_count];
+    f->id = future_count;
+    f->done = false;
+    f->value = NULL;
+    f->start_routine = start_routine;
+    f->arg = arg;
+    f->waiting_count = 0;
+    memset(f->waiting_threads, 0, sizeof(bool) * MAX_THREADS_COUNT);
+
+    *fid = future_count;
+    future_count++;
+    unblock_signals();
+
+    if (ult_create(&f->thread, future_routine, f) != EXIT_SUCCESS) {
+        f->id = -1;
+        return EXIT_FAILURE;
+    }
+    // results are handed out through the future, nobody joins the thread
+    ult_detach(f->thread);
+
+    return EXIT_SUCCESS;
+}
+
+// block until fid completes or the deadline (0 = none) passes, signals must be blocked
+static int wait_future(fid_t fid, uint64_t deadline) {
+    ult_future_t *f = &futures[fid];
+    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(current->tid);
+
+    while (!f->done) {
+        if (deadline != 0 && now_ns() >= deadline) {
+            remove_waiter(f, self);
+            pending_completions[self] = 0;
+            errno = ETIMEDOUT;
+            return EXIT_FAILURE;
+        }
+
+        add_waiter(f, self);
+        pending_completions[self] = 1;
+        current->state = ULT_BLOCKED;
+        if (deadline != 0) {
+            ult_set_timeout(current, deadline);
+        }
+
+        unblock_signals();
+        ult_yield();
+        block_signals();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int ult_future_get(fid_t fid, void **value) {
+    return ult_future_wait_for(fid, -1, value);
+}
+
+int ult_future_wait_for(fid_t fid, long timeout_us, void **value) {
+    block_signals();
+
+    if (!valid_future(fid)) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    uint64_t deadline = 0;
+    if (timeout_us >= 0) {
+        deadline = now_ns() + (uint64_t)timeout_us * 1000;
+    }
+
+    if (wait_future(fid, deadline) != EXIT_SUCCESS) {
+        unblock_signals();
+        return EXIT_FAILURE;
+    }
+
+    if (value != NULL) {
+        *value = futures[fid].value;
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+bool ult_future_ready(fid_t fid) {
+    if (fid >= future_count) {
+        return false;
+    }
+    return futures[fid].done;
+}
+
+int ult_future_destroy(fid_t fid) {
+    if (!valid_future(fid)) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_future_t *f = &futures[fid];
+    if (!f->done || f->waiting_count > 0) {
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    f->id = -1;
+    return EXIT_SUCCESS;
+}
+
+int ult_when_all(const fid_t *fids, size_t count) {
+    block_signals();
+    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(current->tid);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!valid_future(fids[i])) {
+            unblock_signals();
+            errno = EINVAL;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // register on every unfinished future and park once for all of them
+    size_t remaining = 0;
+    for (size_t i = 0; i < count; i++) {
+        ult_future_t *f = &futures[fids[i]];
+        if (!f->done && !f->waiting_threads[self]) {
+            add_waiter(f, self);
+            remaining++;
+        }
+    }
+
+    if (remaining > 0) {
+        pending_completions[self] = remaining;
+        while (pending_completions[self] > 0) {
+            current->state = ULT_BLOCKED;
+            unblock_signals();
+            ult_yield();
+            block_signals();
+        }
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_when_any(const fid_t *fids, size_t count, size_t *index) {
+    block_signals();
+    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(current->tid);
+
+    if (count == 0) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!valid_future(fids[i])) {
+            unblock_signals();
+            errno = EINVAL;
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (;;) {
+        for (size_t i = 0; i < count; i++) {
+            if (futures[fids[i]].done) {
+                // done: drop our registration from all the others
+                for (size_t j = 0; j < count; j++) {
+                    remove_waiter(&futures[fids[j]], self);
+                }
+                pending_completions[self] = 0;
+
+                if (index != NULL) {
+                    *index = i;
+                }
+                unblock_signals();
+                return EXIT_SUCCESS;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            add_waiter(&futures[fids[i]], self);
+        }
+        pending_completions[self] = 1;
+        current->state = ULT_BLOCKED;
+
+        unblock_signals();
+        ult_yield();
+        block_signals();
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef ULT_FUTURE_H
+#define ULT_FUTURE_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+typedef size_t fid_t;
+
+typedef struct {
+    fid_t id;
+    bool done;
+    void *value;                               // start routine result, valid once done
+    tid_t thread;                              // ULT computing the value
+    void *(*start_routine)(void *);
+    void *arg;
+    size_t waiting_count;
+    bool waiting_threads[MAX_THREADS_COUNT];   // woken all at once on completion
+} ult_future_t;
+
+int ult_async(fid_t *fid, void *(*start_routine)(void *), void *arg);
+int ult_future_get(fid_t fid, void **value);
+int ult_future_wait_for(fid_t fid, long timeout_us, void **value);
+bool ult_future_ready(fid_t fid);
+int ult_future_destroy(fid_t fid);
+
+int ult_when_all(const fid_t *fids, size_t count);
+int ult_when_any(const fid_t *fids, size_t count, size_t *index);
+
+#endif
@@ -0,0 +1,220 @@
+#include "group.h"
+#include "sched.h"
+#include "shstack.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+
+static ult_group_t groups[ULT_MAX_GROUPS] = {
+    [ULT_GROUP_ROOT] = {.id = ULT_GROUP_ROOT, .weight = ULT_GROUP_DEFAULT_WEIGHT},
+};
+static size_t group_count = 1;
+
+static bool valid_group(grpid_t gid) {
+    return gid < group_count && groups[gid].id != (grpid_t)-1;
+}
+
+int ult_group_create(grpid_t *gid, unsigned weight) {
+    if (0 == weight) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+
+    // reuse a destroyed slot before growing the table
+    grpid_t id = group_count;
+    for (grpid_t i = 0; i < group_count; i++) {
+        if (groups[i].id == (grpid_t)-1) {
+            id = i;
+            break;
+        }
+    }
+    if (ULT_MAX_GROUPS == id) {
+        unblock_signals();
+        errno = EAGAIN;
+        return EXIT_FAILURE;
+    }
+
+    ult_group_t *g = &groups[id];
+    g->id = id;
+    g->weight = weight;
+    g->quota_ns = 0;
+    g->period_ns = 0;
+    g->period_start = 0;
+    g->period_runtime = 0;
+    g->runtime_ns = 0;
+    g->vruntime = 0;
+    g->throttled = 0;
+    g->throttled_now = false;
+    g->shared_stack = NULL;
+    if (id == group_count) {
+        group_count++;
+    }
+
+    *gid = id;
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_group_set_quota(grpid_t gid, long quota_us, long period_us) {
+    block_signals();
+
+    // only the group policy holds throttled groups back, others would ignore the quota
+    if (ult_get_policy() != &ult_sched_group) {
+        unblock_signals();
+        errno = ENOTSUP;
+        return EXIT_FAILURE;
+    }
+    if (!valid_group(gid) || (quota_us > 0 && (period_us <= 0 || quota_us > period_us))) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_group_t *g = &groups[gid];
+    g->quota_ns = quota_us > 0 ? (uint64_t)quota_us * 1000 : 0;
+    g->period_ns = quota_us > 0 ? (uint64_t)period_us * 1000 : 0;
+    g->period_start = now_ns();
+    g->period_runtime = 0;
+    g->throttled_now = false;
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+// true if a thread of the group is still alive, signals must be blocked
+static bool group_busy(grpid_t gid) {
+    for (size_t i = 0; i < ult_get_thread_count(); i++) {
+        ult_t *t = get_thread_by_slot(i);
+        if (t->group == gid && t->state != ULT_TERMINATED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ult_group_set_shared_stack(grpid_t gid, size_t stack_size) {
+    block_signals();
+
+    // main runs on the process stack, so the root group keeps its own stacks
+    if (!valid_group(gid) || ULT_GROUP_ROOT == gid || stack_size < SIGSTKSZ ||
+        groups[gid].shared_stack != NULL) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+    if (group_busy(gid)) {
+        unblock_signals();
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    groups[gid].shared_stack = ult_shstack_create(stack_size);
+    if (groups[gid].shared_stack == NULL) {
+        unblock_signals();
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_group_destroy(grpid_t gid) {
+    block_signals();
+
+    if (!valid_group(gid) || ULT_GROUP_ROOT == gid) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    if (group_busy(gid)) {
+        unblock_signals();
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    if (groups[gid].shared_stack != NULL) {
+        ult_shstack_destroy(groups[gid].shared_stack);
+        groups[gid].shared_stack = NULL;
+    }
+    groups[gid].id = -1;
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+uint64_t ult_group_get_runtime(grpid_t gid) {
+    if (!valid_group(gid)) {
+        return 0;
+    }
+    return groups[gid].runtime_ns;
+}
+
+unsigned long ult_group_get_throttled(grpid_t gid) {
+    if (!valid_group(gid)) {
+        return 0;
+    }
+    return groups[gid].throttled;
+}
+
+ult_group_t *get_group_by_id(grpid_t gid) {
+    if (!valid_group(gid)) {
+        return NULL;
+    }
+    return &groups[gid];
+}
+
+size_t ult_get_group_count() {
+    return group_count;
+}
+
+static void charge_period(ult_group_t *g, uint64_t ran_ns) {
+    g->period_runtime += ran_ns;
+    if (g->period_runtime >= g->quota_ns && !g->throttled_now) {
+        g->throttled_now = true;
+        g->throttled++;
+    }
+}
+
+// start a new quota period if the current one is over. A tick can overrun the
+// quota, the overrun is paid back from the periods that follow
+static void refresh_period(ult_group_t *g, uint64_t now) {
+    if (0 == g->quota_ns || now - g->period_start < g->period_ns) {
+        return;
+    }
+    uint64_t periods = (now - g->period_start) / g->period_ns;
+    uint64_t allowed = periods * g->quota_ns;
+    g->period_start += periods * g->period_ns;
+    g->period_runtime = g->period_runtime > allowed ? g->period_runtime - allowed : 0;
+    g->throttled_now = false;
+    charge_period(g, 0);
+}
+
+// account CPU time to the thread's group, called from the scheduler tick
+void ult_group_charge(ult_t *t, uint64_t ran_ns, uint64_t now) {
+    ult_group_t *g = &groups[t->group];
+    g->runtime_ns += ran_ns;
+
+    if (0 == g->quota_ns) {
+        return;
+    }
+    // a slice crossing the end of the period is split between the two periods
+    uint64_t period_end = g->period_start + g->period_ns;
+    if (now >= period_end) {
+        uint64_t before = now - ran_ns < period_end ? period_end - (now - ran_ns) : 0;
+        charge_period(g, before);
+        ran_ns -= before;
+        refresh_period(g, now);
+    }
+    charge_period(g, ran_ns);
+}
+
+// true while the group used up its quota for the current period
+bool ult_group_is_throttled(ult_group_t *g, uint64_t now) {
+    refresh_period(g, now);
+    return g->throttled_now;
+}
@@ -0,0 +1,37 @@
+#ifndef ULT_GROUP_H
+#define ULT_GROUP_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+#define ULT_MAX_GROUPS 64
+#define ULT_GROUP_ROOT 0              // main and everything it creates start here
+#define ULT_GROUP_DEFAULT_WEIGHT 1024
+
+typedef struct {
+    grpid_t id;
+    unsigned weight;               // CPU share relative to the other groups
+    uint64_t quota_ns;             // CPU time allowed per period, 0 for no limit
+    uint64_t period_ns;
+    uint64_t period_start;
+    uint64_t period_runtime;       // CPU time used in the current period
+    uint64_t runtime_ns;           // total CPU time of the group's threads
+    uint64_t vruntime;             // runtime scaled by weight, group policy
+    unsigned long throttled;       // periods in which the quota ran out
+    bool throttled_now;
+    struct ult_shared_stack *shared_stack;  // threads run on this stack, NULL for own stacks
+} ult_group_t;
+
+int ult_group_create(grpid_t *group_id, unsigned weight);
+int ult_group_set_quota(grpid_t group_id, long quota_us, long period_us);
+int ult_group_set_shared_stack(grpid_t group_id, size_t stack_size);
+int ult_group_destroy(grpid_t group_id);
+uint64_t ult_group_get_runtime(grpid_t group_id);
+unsigned long ult_group_get_throttled(grpid_t group_id);
+
+ult_group_t *get_group_by_id(grpid_t group_id);
+size_t ult_get_group_count();
+void ult_group_charge(ult_t *t, uint64_t ran_ns, uint64_t now);
+bool ult_group_is_throttled(ult_group_t *g, uint64_t now);
+
+#endif
@@ -0,0 +1,105 @@
+#include "hugepage.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define GUARD_WORDS 8
+#define GUARD_PATTERN 0xdeadbeefcafef00dULL
+
+static bool enabled = false;
+static const char *backing = "none";
+static char *tcbs = NULL;
+static char *stacks = NULL;
+static size_t stack_size = 0;
+static size_t slot_count = 0;
+static bool guarded = false;
+
+static size_t round_up(size_t size, size_t to) {
+    return (size + to - 1) / to * to;
+}
+
+// a huge page aligned region, from the hugetlb pool or else eligible for THP
+static char *map_region(size_t size) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        backing = "hugetlb";
+        return p;
+    }
+
+    // no reserved huge pages: over-map, trim to alignment and ask for THP
+    char *raw = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *aligned = (char *)round_up((uintptr_t)raw, HUGE_PAGE_SIZE);
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+
+    backing = madvise(aligned, size, MADV_HUGEPAGE) == 0 ? "thp" : "none";
+    return aligned;
+}
+
+int ult_arena_init(size_t tcb_bytes, size_t slots, size_t slot_stack_size, bool guards) {
+    size_t tcb_area = round_up(tcb_bytes, 64);
+    size_t size = round_up(tcb_area + slots * slot_stack_size, HUGE_PAGE_SIZE);
+
+    char *region = map_region(size);
+    if (region == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    tcbs = region;
+    stacks = region + tcb_area;
+    stack_size = slot_stack_size;
+    slot_count = slots;
+    guarded = guards;
+    enabled = true;
+    return EXIT_SUCCESS;
+}
+
+bool ult_arena_enabled(void) {
+    return enabled;
+}
+
+const char *ult_arena_backing(void) {
+    return backing;
+}
+
+void *ult_arena_tcbs(void) {
+    return tcbs;
+}
+
+// stacks grow down, the canary sits at the lowest address of the slot
+void *ult_arena_stack(size_t slot) {
+    if (slot >= slot_count) {
+        return NULL;
+    }
+    uint64_t *stack = (uint64_t *)(stacks + slot * stack_size);
+    if (guarded) {
+        for (int i = 0; i < GUARD_WORDS; i++) {
+            stack[i] = GUARD_PATTERN;
+        }
+    }
+    return stack;
+}
+
+bool ult_arena_stack_intact(void *stack) {
+    char *p = stack;
+    if (!guarded || p < stacks || p >= stacks + slot_count * stack_size) {
+        return true;
+    }
+    uint64_t *words = stack;
+    for (int i = 0; i < GUARD_WORDS; i++) {
+        if (words[i] != GUARD_PATTERN) {
+            return false;
+        }
+    }
+    return true;
+}
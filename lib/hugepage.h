@@ -0,0 +1,20 @@
+#ifndef ULT_HUGEPAGE_H
+#define ULT_HUGEPAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// One region for all thread control blocks and thread stacks, backed by huge
+// pages (hugetlbfs if pages are reserved, transparent huge pages otherwise),
+// so switching between many threads touches a handful of TLB entries.
+// Guard pages would split the huge pages, so each stack slot gets a canary at
+// its low end instead, checked whenever its thread is switched out.
+
+int ult_arena_init(size_t tcb_bytes, size_t slots, size_t stack_size, bool guards);
+bool ult_arena_enabled(void);
+const char *ult_arena_backing(void);    // "hugetlb", "thp" or "none"
+void *ult_arena_tcbs(void);
+void *ult_arena_stack(size_t slot);
+bool ult_arena_stack_intact(void *stack);
+
+#endif
@@ -0,0 +1,321 @@
+#include "inbox.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+typedef enum { INBOX_WAKE, INBOX_POST } inbox_kind_t;
+
+typedef struct inbox_node {
+    struct inbox_node *next;
+    inbox_kind_t kind;
+    size_t slot;                    // INBOX_WAKE target
+    void (*fn)(void *);             // INBOX_POST callback
+    void *arg;
+} inbox_node_t;
+
+static bool enabled = false;
+static int wake_fd = -1;
+static atomic_bool idle = false;                 // runtime is about to sleep on wake_fd
+static _Atomic(inbox_node_t *) inbox_head = NULL;
+static atomic_size_t posters = 0;                // live foreign threads, they may still post
+static pthread_key_t poster_key;
+static pthread_once_t poster_once = PTHREAD_ONCE_INIT;
+
+// one preallocated node per thread so waking never allocates
+static inbox_node_t wake_nodes[MAX_THREADS_COUNT];
+static atomic_bool wake_queued[MAX_THREADS_COUNT];
+
+// ULT side state, only touched with SIGALRM blocked
+static bool permits[MAX_THREADS_COUNT];
+static bool waiting[MAX_THREADS_COUNT];
+static size_t waiting_count = 0;    // ULTs blocked in ult_inbox_wait
+static inbox_node_t *posted_head = NULL;
+static inbox_node_t *posted_tail = NULL;
+static tid_t dispatcher;
+
+// only pay for the syscall when the runtime is parked
+static void kick(void) {
+    if (atomic_load(&idle)) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+            perror("inbox eventfd write");
+        }
+    }
+}
+
+static void push(inbox_node_t *node) {
+    inbox_node_t *head = atomic_load(&inbox_head);
+    do {
+        node->next = head;
+    } while (!atomic_compare_exchange_weak(&inbox_head, &head, node));
+    kick();
+}
+
+// a foreign thread exits: the last one lets an idle runtime look for a deadlock again
+static void poster_exit(void *registered) {
+    if (atomic_fetch_sub(&posters, 1) == 1) {
+        kick();
+    }
+}
+
+static void make_poster_key(void) {
+    pthread_key_create(&poster_key, poster_exit);
+}
+
+// count the calling thread as a poster until it exits, once
+static void register_poster(bool counted) {
+    pthread_once(&poster_once, make_poster_key);
+    if (pthread_getspecific(poster_key) != NULL) {
+        if (counted) {
+            atomic_fetch_sub(&posters, 1);
+        }
+        return;
+    }
+    if (!counted) {
+        atomic_fetch_add(&posters, 1);
+    }
+    pthread_setspecific(poster_key, (void *)1);
+}
+
+typedef struct {
+    void *(*start_routine)(void *);
+    void *arg;
+} foreign_start_t;
+
+static void *foreign_main(void *arg) {
+    foreign_start_t start = *(foreign_start_t *)arg;
+    free(arg);
+    register_poster(true);
+    return start.start_routine(start.arg);
+}
+
+static void wake_ult(size_t slot) {
+    ult_t *thread = get_thread_by_slot(slot);
+    if (thread != NULL && thread->state == ULT_BLOCKED) {
+        ult_make_ready(thread);
+    }
+}
+
+// runs posted callbacks in ordinary ULT context
+static void *dispatch_posts(void *arg) {
+    ult_t *current = get_current_thread();
+
+    for (;;) {
+        block_signals();
+        while (posted_head == NULL) {
+            current->state = ULT_BLOCKED;
+            unblock_signals();
+            ult_yield();
+            block_signals();
+        }
+        inbox_node_t *node = posted_head;
+        posted_head = posted_tail = NULL;
+        unblock_signals();
+
+        while (node != NULL) {
+            inbox_node_t *next = node->next;
+            node->fn(node->arg);
+            free(node);
+            node = next;
+        }
+    }
+
+    return NULL;
+}
+
+int ult_inbox_init(void) {
+    if (enabled) {
+        return EXIT_SUCCESS;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
+        wake_nodes[i].kind = INBOX_WAKE;
+        wake_nodes[i].slot = i;
+    }
+
+    if (ult_create(&dispatcher, dispatch_posts, NULL) != EXIT_SUCCESS) {
+        close(wake_fd);
+        wake_fd = -1;
+        return EXIT_FAILURE;
+    }
+
+    enabled = true;
+    return EXIT_SUCCESS;
+}
+
+bool ult_inbox_enabled(void) {
+    return enabled;
+}
+
+bool ult_inbox_may_wake(void) {
+    return enabled && (waiting_count > 0 || atomic_load(&posters) > 0 ||
+                       atomic_load(&inbox_head) != NULL);
+}
+
+int ult_foreign_thread_init(void) {
+    // a foreign thread must never run the ULT scheduler
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        return EXIT_FAILURE;
+    }
+    register_poster(false);
+    return EXIT_SUCCESS;
+}
+
+int ult_foreign_create(pthread_t *thread, void *(*start_routine)(void *), void *arg) {
+    foreign_start_t *start = malloc(sizeof(foreign_start_t));
+    if (start == NULL) {
+        return EXIT_FAILURE;
+    }
+    start->start_routine = start_routine;
+    start->arg = arg;
+
+    // counted from here, so the runtime keeps waiting before the thread even runs;
+    // it inherits the blocked SIGALRM from us
+    atomic_fetch_add(&posters, 1);
+    block_signals();
+    int status = pthread_create(thread, NULL, foreign_main, start);
+    unblock_signals();
+
+    if (status != 0) {
+        atomic_fetch_sub(&posters, 1);
+        free(start);
+        errno = status;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int ult_wake_from_foreign(tid_t tid) {
+    size_t slot = ULT_TID_SLOT(tid);
+    if (!enabled || slot >= MAX_THREADS_COUNT) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    // already queued: the pending wake covers this one too
+    if (!atomic_exchange(&wake_queued[slot], true)) {
+        push(&wake_nodes[slot]);
+    }
+    return EXIT_SUCCESS;
+}
+
+int ult_post(void (*fn)(void *), void *arg) {
+    if (!enabled) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    inbox_node_t *node = malloc(sizeof(inbox_node_t));
+    if (node == NULL) {
+        return EXIT_FAILURE;
+    }
+    node->kind = INBOX_POST;
+    node->fn = fn;
+    node->arg = arg;
+
+    push(node);
+    return EXIT_SUCCESS;
+}
+
+int ult_inbox_wait(void) {
+    block_signals();
+    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(current->tid);
+
+    if (!permits[self]) {
+        waiting[self] = true;
+        waiting_count++;
+        while (!permits[self]) {
+            current->state = ULT_BLOCKED;
+            unblock_signals();
+            ult_yield();
+            block_signals();
+        }
+        waiting[self] = false;
+        waiting_count--;
+    }
+    permits[self] = false;
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+void ult_inbox_drain(void) {
+    if (atomic_load_explicit(&inbox_head, memory_order_relaxed) == NULL) {
+        return;
+    }
+
+    // take the whole list at once, it comes out newest first
+    inbox_node_t *node = atomic_exchange(&inbox_head, NULL);
+    inbox_node_t *ordered = NULL;
+    while (node != NULL) {
+        inbox_node_t *next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+
+    while (ordered != NULL) {
+        inbox_node_t *next = ordered->next;
+
+        if (ordered->kind == INBOX_WAKE) {
+            size_t slot = ordered->slot;
+            atomic_store(&wake_queued[slot], false);
+            permits[slot] = true;
+            if (waiting[slot]) {
+                wake_ult(slot);
+            }
+        } else {
+            ordered->next = NULL;
+            if (posted_tail == NULL) {
+                posted_head = ordered;
+            } else {
+                posted_tail->next = ordered;
+            }
+            posted_tail = ordered;
+            wake_ult(ULT_TID_SLOT(dispatcher));
+        }
+
+        ordered = next;
+    }
+}
+
+void ult_inbox_idle(uint64_t deadline_ns) {
+    atomic_store(&idle, true);
+
+    // a push or the exit of the last poster that raced with us either sees idle
+    // or is visible here
+    bool wakeable = waiting_count > 0 || atomic_load(&posters) > 0;
+    if (atomic_load(&inbox_head) == NULL && (wakeable || deadline_ns != 0)) {
+        int timeout_ms = -1;
+        if (deadline_ns != 0) {
+            uint64_t now = now_ns();
+            timeout_ms = deadline_ns > now ? (int)((deadline_ns - now + 999999) / 1000000) : 0;
+        }
+
+        struct pollfd pfd = {.fd = wake_fd, .events = POLLIN};
+        if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+            perror("inbox poll");
+        }
+    }
+
+    atomic_store(&idle, false);
+
+    uint64_t count;
+    while (read(wake_fd, &count, sizeof(count)) > 0) {
+    }
+}
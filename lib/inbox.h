@@ -0,0 +1,33 @@
+#ifndef ULT_INBOX_H
+#define ULT_INBOX_H
+
+#include "ult.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+// Hand-offs from ordinary kernel threads into the ULT runtime.
+// Foreign threads push onto a lock-free MPSC list; the scheduler drains it on
+// every switch and an eventfd wakes the runtime when all ULTs are blocked.
+// While a foreign thread (ult_foreign_create or ult_foreign_thread_init) is
+// alive, a post is pending or a ULT sits in ult_inbox_wait, all ULTs being
+// blocked is not a deadlock: the runtime idles until a foreign wakeup.
+
+int ult_inbox_init(void);
+bool ult_inbox_enabled(void);
+
+// foreign thread side
+int ult_foreign_thread_init(void);
+int ult_foreign_create(pthread_t *thread, void *(*start_routine)(void *), void *arg);
+int ult_wake_from_foreign(tid_t tid);
+int ult_post(void (*fn)(void *), void *arg);
+
+// ULT side
+int ult_inbox_wait(void);
+
+// scheduler side, SIGALRM must be blocked
+void ult_inbox_drain(void);
+// a foreign thread may still wake a ULT, so all of them being blocked is no deadlock
+bool ult_inbox_may_wake(void);
+void ult_inbox_idle(uint64_t deadline_ns);
+
+#endif
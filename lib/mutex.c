@@ -1,17 +1,23 @@
 #include "mutex.h"
 #include "utils.h"
+#include "probes.h"
 
 #include "errno.h"
 #include <stdio.h>
 #include <string.h>
 #include "assert.h"
 
-static ult_mutex_t mutexes[MAX_THREADS_COUNT];
+static ult_mutex_t mutexes[MAX_SYNC_COUNT];
 static size_t mutex_count = 0;
 
 int ult_mutex_init(tid_t *mid)
 {
-    if (MAX_THREADS_COUNT - 1 == mutex_count)
+    return ult_mutex_init_protocol(mid, ULT_MUTEX_PRIO_NONE);
+}
+
+int ult_mutex_init_protocol(tid_t *mid, ult_mutex_protocol_t protocol)
+{
+    if (MAX_SYNC_COUNT - 1 == mutex_count)
     {
         return EXIT_FAILURE;
     }
@@ -21,6 +27,9 @@ int ult_mutex_init(tid_t *mid)
     m->holder = -1;
     m->waiting_count = 0;
     memset(m->waiting_threads, 0, sizeof(bool) * MAX_THREADS_COUNT); // Initialize waiting array
+    m->protocol = protocol;
+    m->next_held = -1;
+    m->handoff_to = -1;
 
     *mid = mutex_count;
     mutex_count++;
@@ -28,6 +37,93 @@ int ult_mutex_init(tid_t *mid)
     return EXIT_SUCCESS;
 }
 
+// highest priority among the threads waiting for m, ULT_PRIO_MIN if none
+static int top_waiter_priority(ult_mutex_t *m) {
+    int top = ULT_PRIO_MIN;
+    size_t seen = 0;
+    for (size_t i = 0; i < MAX_THREADS_COUNT && seen < m->waiting_count; i++) {
+        if (m->waiting_threads[i]) {
+            seen++;
+            ult_t *waiter = get_thread_by_slot(i);
+            if (waiter != NULL && waiter->priority > top) {
+                top = waiter->priority;
+            }
+        }
+    }
+    return top;
+}
+
+// own priority of t raised to the top waiter of every inheriting mutex it holds
+static int inherited_priority(ult_t *t) {
+    int prio = t->base_priority;
+    for (tid_t mid = t->held_mutexes; mid != (tid_t)-1; mid = mutexes[mid].next_held) {
+        ult_mutex_t *m = &mutexes[mid];
+        if (m->protocol == ULT_MUTEX_PRIO_INHERIT && m->waiting_count > 0) {
+            int top = top_waiter_priority(m);
+            if (top > prio) {
+                prio = top;
+            }
+        }
+    }
+    return prio;
+}
+
+// recompute the effective priority of t and pass the change on to the holder of the
+// mutex t waits for, then to the holder of the mutex that one waits for, and so on.
+// Signals must be blocked.
+void ult_mutex_update_priority(ult_t *t) {
+    while (t != NULL) {
+        int prio = inherited_priority(t);
+        if (prio == t->priority) {
+            break;
+        }
+        ult_set_effective_priority(t, prio);
+
+        if (t->blocked_on == (tid_t)-1) {
+            break;
+        }
+        ult_mutex_t *m = &mutexes[t->blocked_on];
+        if (m->protocol != ULT_MUTEX_PRIO_INHERIT || m->holder == (tid_t)-1) {
+            break;
+        }
+        t = get_thread_by_id(m->holder);
+    }
+}
+
+// make current the holder of the free mutex m, leaving its waiting list if on it
+static void take(ult_mutex_t *m, ult_t *current) {
+    tid_t self = current->tid;
+    if (m->waiting_threads[ULT_TID_SLOT(self)]) {
+        m->waiting_threads[ULT_TID_SLOT(self)] = false;
+        m->waiting_count--;
+    }
+    m->holder = self;
+    m->next_held = current->held_mutexes;
+    current->held_mutexes = m->id;
+
+    // the threads still waiting now boost us
+    if (m->protocol == ULT_MUTEX_PRIO_INHERIT) {
+        ult_mutex_update_priority(current);
+    }
+
+    printf("Thread %ld acquired mutex %ld\n", self, m->id);
+    ULT_PROBE_MUTEX_ACQUIRE(m->id, self);
+}
+
+// waiting thread with the highest priority, NULL if none
+static ult_t *top_waiter(ult_mutex_t *m) {
+    ult_t *next = NULL;
+    for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
+        if (m->waiting_threads[i]) {
+            ult_t *thread = get_thread_by_slot(i);
+            if (thread != NULL && (next == NULL || thread->priority > next->priority)) {
+                next = thread;
+            }
+        }
+    }
+    return next;
+}
+
 int ult_mutex_lock(tid_t mid) {
     block_signals();
     tid_t self = ult_self();
@@ -56,40 +152,85 @@ int ult_mutex_lock(tid_t mid) {
     }
 
     // mark ourselves as waiting for the lock on mutex
-    if (!m->waiting_threads[self]) {
+    if (!m->waiting_threads[ULT_TID_SLOT(self)]) {
         m->waiting_count++;
-        m->waiting_threads[self] = true;
+        m->waiting_threads[ULT_TID_SLOT(self)] = true;
         printf("Thread %ld waiting for mutex %ld (held by %ld)\n",
                self, mid, m->holder);
+        if (m->holder != -1) {
+            ULT_PROBE_MUTEX_CONTEND(mid, self, m->holder);
+        }
     }
 
-    // while mutex is held by another thread
+    // while mutex is held by another thread; an unlock between the check and
+    // the park leaves a permit, so the park returns right away
+    current->blocked_on = mid;
     while (m->holder != -1 && m->holder != self) {
-        current->state = ULT_BLOCKED;
+        // lend our priority to the holder (and whoever it waits for) while we wait
+        if (m->protocol == ULT_MUTEX_PRIO_INHERIT) {
+            ult_mutex_update_priority(get_thread_by_id(m->holder));
+        }
         unblock_signals();
-        ult_yield();
+        ult_park(m);
         block_signals();
     }
 
     // we've acquired the mutex
-    m->waiting_threads[self] = false;
-    m->waiting_count--;
-    m->holder = self;
-
-    printf("Thread %ld acquired mutex %ld\n", self, mid);
+    current->blocked_on = -1;
+    take(m, current);
 
     unblock_signals();
     return EXIT_SUCCESS;
 }
 
-int ult_mutex_unlock(tid_t mid) {
+// takes the mutex only if nobody holds it, fails with EBUSY otherwise
+int ult_mutex_trylock(tid_t mid) {
     block_signals();
     tid_t self = ult_self();
+
+    if (mid >= mutex_count) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_mutex_t *m = &mutexes[mid];
+    ult_t *current = get_current_thread();
+
+    if (m->holder == self) {
+        unblock_signals();
+        return EXIT_SUCCESS;
+    }
+    if (m->holder != -1) {
+        unblock_signals();
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    m->holder = self;
+    m->next_held = current->held_mutexes;
+    current->held_mutexes = mid;
+    ULT_PROBE_MUTEX_ACQUIRE(mid, self);
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+// release without switching, SIGALRM must be blocked. *woken is the thread that
+// should get the CPU with handoff: the waiter woken, else the one set by
+// ult_mutex_handoff_on_unlock, -1 if none
+int ult_mutex_release(tid_t mid, tid_t *woken) {
+    tid_t self = ult_self();
     ult_mutex_t *m = &mutexes[mid];
+    *woken = -1;
+
+    if (mid >= mutex_count) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
 
     // check if we actually hold this mutex
     if (m->holder != self) {
-        unblock_signals();
         errno = EPERM;
         return EXIT_FAILURE;
     }
@@ -98,22 +239,110 @@ int ult_mutex_unlock(tid_t mid) {
 
     // release the mutex
     m->holder = -1;
+    ult_t *current = get_current_thread();
+    tid_t *link = &current->held_mutexes;
+    while (*link != mid) {
+        link = &mutexes[*link].next_held;
+    }
+    *link = m->next_held;
+    m->next_held = -1;
+
+    // drop whatever priority we inherited through this mutex
+    ult_mutex_update_priority(current);
+
+    // wake up the waiting thread with the highest priority, parked or about to park
+    ult_t *next = top_waiter(m);
+    if (next != NULL) {
+        ult_unpark_thread(next);
+        *woken = next->tid;
+    } else {
+        *woken = m->handoff_to;
+    }
+    m->handoff_to = -1;
+    ULT_PROBE_MUTEX_RELEASE(mid, self, *woken);
 
-    // wake up one waiting thread
-    for (size_t i = 0; i < MAX_THREADS_COUNT; i++) {
-        if (m->waiting_threads[i]) {
-            ult_t *thread = get_thread_by_id(i);
-            if (thread != NULL && thread->state == ULT_BLOCKED) {
-                thread->state = ULT_READY;
-                break;
+    return EXIT_SUCCESS;
+}
+
+int ult_mutex_unlock(tid_t mid) {
+    block_signals();
+    tid_t woken;
+    int status = ult_mutex_release(mid, &woken);
+    unblock_signals();
+
+    if (EXIT_SUCCESS == status && -1 != woken && ult_handoff_enabled()) {
+        // fails without switching if the thread is no longer ready
+        ult_yield_to(woken);
+    }
+    return status;
+}
+
+// The three calls below let ult_wait_any wait for a mutex among other objects,
+// SIGALRM must be blocked. add_waiter puts the caller on the waiting list, so an
+// unlock unparks it like a thread blocked in ult_mutex_lock
+int ult_mutex_add_waiter(tid_t mid) {
+    if (mid >= mutex_count || mutexes[mid].id == (tid_t)-1) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_mutex_t *m = &mutexes[mid];
+    tid_t self = ult_self();
+    if (!m->waiting_threads[ULT_TID_SLOT(self)]) {
+        m->waiting_count++;
+        m->waiting_threads[ULT_TID_SLOT(self)] = true;
+        if (m->holder != -1 && m->holder != self) {
+            ULT_PROBE_MUTEX_CONTEND(mid, self, m->holder);
+            if (m->protocol == ULT_MUTEX_PRIO_INHERIT) {
+                ult_mutex_update_priority(get_thread_by_id(m->holder));
             }
         }
     }
-
-    unblock_signals();
     return EXIT_SUCCESS;
 }
 
+// takes the mutex if it is free (or already ours), false otherwise
+bool ult_mutex_take(tid_t mid) {
+    ult_mutex_t *m = &mutexes[mid];
+    ult_t *current = get_current_thread();
+    if (m->holder == current->tid) {
+        return true;
+    }
+    if (m->holder != -1) {
+        return false;
+    }
+    take(m, current);
+    return true;
+}
+
+// leave the waiting list without the mutex. An unlock may have woken the caller
+// for it, so a free mutex wakes the next waiter instead
+void ult_mutex_remove_waiter(tid_t mid) {
+    ult_mutex_t *m = &mutexes[mid];
+    tid_t self = ult_self();
+    if (!m->waiting_threads[ULT_TID_SLOT(self)]) {
+        return;
+    }
+    m->waiting_threads[ULT_TID_SLOT(self)] = false;
+    m->waiting_count--;
+
+    if (m->holder == -1) {
+        ult_t *next = top_waiter(m);
+        if (next != NULL) {
+            ult_unpark_thread(next);
+        }
+    } else if (m->protocol == ULT_MUTEX_PRIO_INHERIT) {
+        ult_mutex_update_priority(get_thread_by_id(m->holder));
+    }
+}
+
+// make the holder's next unlock hand the CPU to tid, SIGALRM must be blocked
+void ult_mutex_handoff_on_unlock(tid_t mid, tid_t tid) {
+    if (mid < mutex_count) {
+        mutexes[mid].handoff_to = tid;
+    }
+}
+
 int ult_mutex_destroy(tid_t mid)
 {
     ult_mutex_t *m = &mutexes[mid];
@@ -128,6 +357,16 @@ int ult_mutex_destroy(tid_t mid)
     return EXIT_SUCCESS;
 }
 
+// thread holding the mutex, -1 if it is free
+tid_t ult_mutex_get_holder(tid_t mid)
+{
+    if (mid >= mutex_count)
+    {
+        return -1;
+    }
+    return mutexes[mid].holder;
+}
+
 
 void display_deadlocks(void) {
     printf("\nStarting deadlock detection...\n");
@@ -164,7 +403,7 @@ void display_deadlocks(void) {
             if (m->waiting_threads[t]) {
                 if (relation_count < thread_count) {
                     relations[relation_count].holder = m->holder;
-                    relations[relation_count].waiting_thread = t;
+                    relations[relation_count].waiting_thread = get_thread_by_slot(t)->tid;
                     relations[relation_count].mutex_id = m->id;
                     relation_count++;
                 }
@@ -183,19 +422,19 @@ void display_deadlocks(void) {
             continue;
         }
 
-        visited[start_thread] = true;
+        visited[ULT_TID_SLOT(start_thread)] = true;
 
         bool cycle_found = false;
         printf("\nChecking chain starting with Thread %ld:\n", start_thread);
 
         while (current_thread != -1) {
-            if (visited[current_thread]) {
+            if (visited[ULT_TID_SLOT(current_thread)]) {
                 cycle_found = true;
                 deadlock_found = true;
                 break;
             }
 
-            visited[current_thread] = true;
+            visited[ULT_TID_SLOT(current_thread)] = true;
 
             // find next relation where current thread is waiting
             bool found_next = false;
@@ -2,16 +2,33 @@
 #define ULT_MUTEX_H
 #include "ult.h"
 
+typedef enum ult_mutex_protocol {
+    ULT_MUTEX_PRIO_NONE,        // the holder keeps its own priority
+    ULT_MUTEX_PRIO_INHERIT      // the holder runs at the priority of its highest waiter
+} ult_mutex_protocol_t;
+
 typedef struct ult_mutex {
     tid_t id;                                  // Mutex identifier
     tid_t holder;                              // Current thread holding the mutex
     size_t waiting_count;                      // Number of threads waiting
     bool waiting_threads[MAX_THREADS_COUNT];    // Array tracking which threads are waiting
+    ult_mutex_protocol_t protocol;             // Priority protocol
+    tid_t next_held;                           // Next mutex held by the same holder, -1 if last
+    tid_t handoff_to;                          // Thread the holder hands the CPU to on unlock, -1 if none
 } ult_mutex_t;
 
 int ult_mutex_init(tid_t* mutex_id);
+int ult_mutex_init_protocol(tid_t* mutex_id, ult_mutex_protocol_t protocol);
 int ult_mutex_lock(tid_t mutex_id);
+int ult_mutex_trylock(tid_t mutex_id);
 int ult_mutex_unlock(tid_t mutex_id);
 int ult_mutex_destroy(tid_t mutex_id);
+tid_t ult_mutex_get_holder(tid_t mutex_id);
+void ult_mutex_update_priority(ult_t *t);
+int ult_mutex_release(tid_t mutex_id, tid_t *woken);
+void ult_mutex_handoff_on_unlock(tid_t mutex_id, tid_t tid);
+int ult_mutex_add_waiter(tid_t mutex_id);
+bool ult_mutex_take(tid_t mutex_id);
+void ult_mutex_remove_waiter(tid_t mutex_id);
 void display_deadlocks();
-#endif
\ No newline at end of file
+#endif
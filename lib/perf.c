@@ -0,0 +1,176 @@
+#include "perf.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;                               // -1 if the counter could not be opened
+    struct perf_event_mmap_page *page;    // for rdpmc, NULL if it cannot be mapped
+    uint64_t last;                        // value at the last switch
+} perf_counter_t;
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[ULT_PERF_COUNTERS] = {
+    [ULT_PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [ULT_PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [ULT_PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [ULT_PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static perf_counter_t counters[ULT_PERF_COUNTERS];
+static bool enabled = false;
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this kernel thread only, on any CPU
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t rdpmc(uint32_t counter) {
+    uint32_t low, high;
+    __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return (uint64_t)high << 32 | low;
+}
+#endif
+
+static uint64_t read_counter(perf_counter_t *c) {
+#if defined(__x86_64__) || defined(__i386__)
+    struct perf_event_mmap_page *pc = c->page;
+    if (pc != NULL && pc->cap_user_rdpmc) {
+        // seqlock protocol from linux/perf_event.h: retry if the kernel moved
+        // the counter while we were reading it
+        uint32_t seq;
+        uint64_t count;
+        do {
+            seq = pc->lock;
+            __asm__ volatile("" ::: "memory");
+            uint32_t index = pc->index;
+            count = pc->offset;
+            if (index != 0) {
+                int64_t pmc = rdpmc(index - 1);
+                pmc <<= 64 - pc->pmc_width;
+                pmc >>= 64 - pc->pmc_width;
+                count += pmc;
+            }
+            __asm__ volatile("" ::: "memory");
+        } while (pc->lock != seq);
+        return count;
+    }
+#endif
+
+    uint64_t count = 0;
+    if (read(c->fd, &count, sizeof(count)) != sizeof(count)) {
+        return c->last;
+    }
+    return count;
+}
+
+int ult_perf_enable(void) {
+    if (enabled) {
+        return EXIT_SUCCESS;
+    }
+
+    block_signals();
+    int opened = 0;
+    for (int i = 0; i < ULT_PERF_COUNTERS; i++) {
+        perf_counter_t *c = &counters[i];
+        c->page = NULL;
+        c->fd = open_counter(events[i].type, events[i].config);
+        if (c->fd == -1) {
+            continue;
+        }
+        opened++;
+
+        void *page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, c->fd, 0);
+        if (page != MAP_FAILED) {
+            c->page = page;
+        }
+        c->last = read_counter(c);
+    }
+
+    if (opened == 0) {
+        // no PMU (VM, container) or perf_event_paranoid forbids it, errno says which
+        unblock_signals();
+        return EXIT_FAILURE;
+    }
+
+    enabled = true;
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+void ult_perf_disable(void) {
+    block_signals();
+    if (enabled) {
+        ult_perf_account(get_current_thread());
+        for (int i = 0; i < ULT_PERF_COUNTERS; i++) {
+            perf_counter_t *c = &counters[i];
+            if (c->page != NULL) {
+                munmap(c->page, sysconf(_SC_PAGESIZE));
+            }
+            if (c->fd != -1) {
+                close(c->fd);
+            }
+            c->fd = -1;
+            c->page = NULL;
+        }
+        enabled = false;
+    }
+    unblock_signals();
+}
+
+bool ult_perf_enabled(void) {
+    return enabled;
+}
+
+void ult_perf_account(ult_t *outgoing) {
+    for (int i = 0; i < ULT_PERF_COUNTERS; i++) {
+        perf_counter_t *c = &counters[i];
+        if (c->fd == -1) {
+            continue;
+        }
+        uint64_t now = read_counter(c);
+        outgoing->cold->perf_counts[i] += now - c->last;
+        c->last = now;
+    }
+}
+
+int ult_perf_get(tid_t tid, ult_perf_stats_t *stats) {
+    block_signals();
+
+    ult_t *t = get_thread_by_id(tid);
+    if (!enabled || t == NULL) {
+        unblock_signals();
+        errno = enabled ? EINVAL : ENODEV;
+        return EXIT_FAILURE;
+    }
+
+    // the running thread is only charged when it switches out
+    if (t == get_current_thread()) {
+        ult_perf_account(t);
+    }
+
+    for (int i = 0; i < ULT_PERF_COUNTERS; i++) {
+        stats->counts[i] = t->cold->perf_counts[i];
+        stats->available[i] = counters[i].fd != -1;
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#ifndef ULT_PERF_H
+#define ULT_PERF_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+// Hardware counters of the kernel thread running the ULTs, split per ULT: the
+// scheduler reads them (with rdpmc where the kernel allows it) on every switch
+// and adds the delta to the outgoing thread.
+
+typedef enum {
+    ULT_PERF_CYCLES,
+    ULT_PERF_INSTRUCTIONS,
+    ULT_PERF_LLC_MISSES,
+    ULT_PERF_BRANCH_MISSES,
+} ult_perf_counter_t;
+
+typedef struct {
+    uint64_t counts[ULT_PERF_COUNTERS];     // indexed by ult_perf_counter_t
+    bool available[ULT_PERF_COUNTERS];      // the kernel/CPU provides this counter
+} ult_perf_stats_t;
+
+int ult_perf_enable(void);
+void ult_perf_disable(void);
+bool ult_perf_enabled(void);
+int ult_perf_get(tid_t tid, ult_perf_stats_t *stats);
+
+// scheduler side, SIGALRM must be blocked
+void ult_perf_account(ult_t *outgoing);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ULT_PROBES_H
+#define ULT_PROBES_H
+
+// USDT probes of provider "ult", for bpftrace, perf probe or stap without a
+// rebuild, e.g. bpftrace -e 'usdt:bin/main:ult:switch { @[arg1] = count(); }'.
+// A probe that nobody traces is a nop. Thread, mutex and condition variable ids
+// are passed as they are, -1 for none.
+//
+//   create(tid, parent)          a slot was taken for a new thread
+//   exit(tid, retval)
+//   switch(from, to)             right before the context switch
+//   block(tid)                   a thread left the CPU blocked
+//   unblock(tid)                 a blocked thread became ready
+//   mutex_contend(mid, tid, holder)
+//   mutex_acquire(mid, tid)
+//   mutex_release(mid, tid, woken)
+//   cond_wait(cid, mid, tid)
+//   cond_signal(cid, woken)
+//   cond_broadcast(cid, woken_count)
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ULT_HAVE_SYS_SDT
+#endif
+#endif
+
+#ifndef ULT_HAVE_SYS_SDT
+#include "sdt.h"
+#endif
+
+#define ULT_PROBE_CREATE(tid, parent) STAP_PROBE2(ult, create, tid, parent)
+#define ULT_PROBE_EXIT(tid, retval) STAP_PROBE2(ult, exit, tid, retval)
+#define ULT_PROBE_SWITCH(from, to) STAP_PROBE2(ult, switch, from, to)
+#define ULT_PROBE_BLOCK(tid) STAP_PROBE1(ult, block, tid)
+#define ULT_PROBE_UNBLOCK(tid) STAP_PROBE1(ult, unblock, tid)
+#define ULT_PROBE_MUTEX_CONTEND(mid, tid, holder) STAP_PROBE3(ult, mutex_contend, mid, tid, holder)
+#define ULT_PROBE_MUTEX_ACQUIRE(mid, tid) STAP_PROBE2(ult, mutex_acquire, mid, tid)
+#define ULT_PROBE_MUTEX_RELEASE(mid, tid, woken) STAP_PROBE3(ult, mutex_release, mid, tid, woken)
+#define ULT_PROBE_COND_WAIT(cid, mid, tid) STAP_PROBE3(ult, cond_wait, cid, mid, tid)
+#define ULT_PROBE_COND_SIGNAL(cid, woken) STAP_PROBE2(ult, cond_signal, cid, woken)
+#define ULT_PROBE_COND_BROADCAST(cid, count) STAP_PROBE2(ult, cond_broadcast, cid, count)
+
+#endif
@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include "profile.h"
+#include "utils.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <link.h>
+#include <pthread.h>
+#include <string.h>
+
+typedef struct {
+    tid_t tid;
+    grpid_t group;
+    size_t depth;
+    uintptr_t pcs[ULT_PROFILE_DEPTH];   // innermost first
+} sample_t;
+
+static bool enabled = false;
+static unsigned every = 1;
+static unsigned ticks = 0;
+static sample_t *samples = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+static size_t dropped = 0;
+static uintptr_t thread_stack_lo = 0;   // stack of the kernel thread, which main runs on
+static uintptr_t thread_stack_hi = 0;
+static ult_profile_split_t sort_split;
+
+int ult_profile_enable(unsigned every_nth_tick, size_t max_samples) {
+    if (0 == every_nth_tick || 0 == max_samples) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    sample_t *buffer = malloc(max_samples * sizeof(sample_t));
+    if (NULL == buffer) {
+        return EXIT_FAILURE;
+    }
+
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+    if (0 == pthread_getattr_np(pthread_self(), &attr)) {
+        if (0 == pthread_attr_getstack(&attr, &addr, &size)) {
+            thread_stack_lo = (uintptr_t)addr;
+            thread_stack_hi = (uintptr_t)addr + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    block_signals();
+    free(samples);
+    samples = buffer;
+    capacity = max_samples;
+    count = 0;
+    dropped = 0;
+    every = every_nth_tick;
+    ticks = 0;
+    enabled = true;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+void ult_profile_disable(void) {
+    enabled = false;
+}
+
+bool ult_profile_enabled(void) {
+    return enabled;
+}
+
+size_t ult_profile_get_samples(size_t *lost) {
+    if (NULL != lost) {
+        *lost = dropped;
+    }
+    return count;
+}
+
+void ult_profile_tick(ult_t *t, const ucontext_t *context) {
+    if (!enabled || ++ticks < every) {
+        return;
+    }
+    ticks = 0;
+
+    if (count == capacity) {
+        dropped++;
+        return;
+    }
+
+    sample_t *s = &samples[count++];
+    s->tid = t->tid;
+    s->group = t->group;
+
+    const greg_t *regs = context->uc_mcontext.gregs;
+    uintptr_t sp = regs[REG_RSP];
+    uintptr_t fp = regs[REG_RBP];
+    s->pcs[0] = regs[REG_RIP];
+    s->depth = 1;
+
+    // only follow frames inside the stack the thread is running on; on any
+    // other stack (a coroutine, the scheduler's switcher) keep just the pc
+    const stack_t *stack = &t->cold->context.uc_stack;
+    uintptr_t lo = (uintptr_t)stack->ss_sp;
+    uintptr_t hi = lo + stack->ss_size;
+    if (0 == stack->ss_size) {
+        lo = thread_stack_lo;
+        hi = thread_stack_hi;
+    }
+    if (sp < lo || sp >= hi) {
+        return;
+    }
+
+    while (s->depth < ULT_PROFILE_DEPTH && fp >= sp && fp + 2 * sizeof(uintptr_t) <= hi &&
+           0 == fp % sizeof(uintptr_t)) {
+        const uintptr_t *frame = (const uintptr_t *)fp;
+        if (0 == frame[1]) {
+            break;
+        }
+        // a return address points after the call, step back into it
+        s->pcs[s->depth++] = frame[1] - 1;
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const sample_t *x = a;
+    const sample_t *y = b;
+
+    if (sort_split != ULT_PROFILE_MERGED && x->group != y->group) {
+        return x->group < y->group ? -1 : 1;
+    }
+    if (sort_split == ULT_PROFILE_BY_THREAD && x->tid != y->tid) {
+        return x->tid < y->tid ? -1 : 1;
+    }
+    if (x->depth != y->depth) {
+        return x->depth < y->depth ? -1 : 1;
+    }
+    return memcmp(x->pcs, y->pcs, x->depth * sizeof(uintptr_t));
+}
+
+// the function containing pc, or the module it belongs to when the function is
+// not exported: dladdr falls back to the closest exported symbol below, which
+// is a different function when the real one is static
+static uintptr_t frame_key(uintptr_t pc) {
+    Dl_info info;
+    const ElfW(Sym) *sym = NULL;
+
+    if (0 == dladdr1((void *)pc, &info, (void **)&sym, RTLD_DL_SYMENT)) {
+        return pc;
+    }
+    uintptr_t start = (uintptr_t)info.dli_saddr;
+    if (NULL != info.dli_sname && NULL != sym && pc >= start && pc < start + (sym->st_size ? sym->st_size : 1)) {
+        return start;
+    }
+    return (uintptr_t)info.dli_fbase;
+}
+
+static void print_frame(FILE *out, uintptr_t key) {
+    Dl_info info;
+
+    if (0 != dladdr((void *)key, &info)) {
+        if (NULL != info.dli_sname && (uintptr_t)info.dli_saddr == key) {
+            fputs(info.dli_sname, out);
+            return;
+        }
+        if (NULL != info.dli_fname && (uintptr_t)info.dli_fbase == key) {
+            const char *name = strrchr(info.dli_fname, '/');
+            fprintf(out, "[%s]", NULL != name ? name + 1 : info.dli_fname);
+            return;
+        }
+    }
+    fprintf(out, "0x%lx", (unsigned long)key);
+}
+
+static void print_stack(FILE *out, const sample_t *s, ult_profile_split_t split, size_t hits) {
+    if (split != ULT_PROFILE_MERGED) {
+        fprintf(out, "group-%zu;", s->group);
+    }
+    if (split == ULT_PROFILE_BY_THREAD) {
+        fprintf(out, "ult-%lu;", s->tid);
+    }
+    // folded stacks are written root first
+    for (size_t i = s->depth; i > 0; i--) {
+        print_frame(out, s->pcs[i - 1]);
+        fputc(i > 1 ? ';' : ' ', out);
+    }
+    fprintf(out, "%zu\n", hits);
+}
+
+// one line per distinct stack with its sample count, sampling is paused meanwhile
+int ult_profile_dump(FILE *out, ult_profile_split_t split) {
+    if (NULL == samples) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    bool was_enabled = enabled;
+    enabled = false;
+
+    // samples in the same function merge, whatever the instruction
+    for (size_t i = 0; i < count; i++) {
+        for (size_t d = 0; d < samples[i].depth; d++) {
+            samples[i].pcs[d] = frame_key(samples[i].pcs[d]);
+        }
+    }
+
+    sort_split = split;
+    qsort(samples, count, sizeof(sample_t), compare_samples);
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && 0 == compare_samples(&samples[i], &samples[j])) {
+            j++;
+        }
+        print_stack(out, &samples[i], split, j - i);
+        i = j;
+    }
+
+    enabled = was_enabled;
+    return EXIT_SUCCESS;
+}
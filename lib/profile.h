@@ -0,0 +1,32 @@
+#ifndef ULT_PROFILE_H
+#define ULT_PROFILE_H
+
+#include "ult.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Sampling profiler on the scheduler tick: every Nth SIGALRM tick records the
+// interrupted ULT and its call stack, walked through the frame pointers (kept
+// at -O0, otherwise build with -fno-omit-frame-pointer). Samples go into a
+// buffer allocated up front and are dumped in the folded format read by
+// flamegraph.pl and speedscope. Functions resolve through dladdr, so link
+// with -rdynamic; static and unexported functions show up as [module].
+
+#define ULT_PROFILE_DEPTH 32
+
+typedef enum {
+    ULT_PROFILE_MERGED,       // functions only
+    ULT_PROFILE_BY_GROUP,     // a "group-N" root frame per ULT group
+    ULT_PROFILE_BY_THREAD,    // "group-N;ult-T" root frames
+} ult_profile_split_t;
+
+int ult_profile_enable(unsigned every_nth_tick, size_t max_samples);
+void ult_profile_disable(void);   // stops sampling, the samples stay until the next enable
+bool ult_profile_enabled(void);
+size_t ult_profile_get_samples(size_t *dropped);
+int ult_profile_dump(FILE *out, ult_profile_split_t split);
+
+// scheduler side, SIGALRM must be blocked
+void ult_profile_tick(ult_t *interrupted, const ucontext_t *context);
+
+#endif
@@ -0,0 +1,250 @@
+#include "rcu.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+typedef struct rcu_callback {
+    struct rcu_callback *next;
+    void (*fn)(void *);
+    void *ptr;
+} rcu_callback_t;
+
+typedef struct {
+    rcu_callback_t *head;
+    rcu_callback_t *tail;
+} rcu_list_t;
+
+// touched by readers without blocking signals: only the owner writes its slot
+static unsigned nesting[MAX_THREADS_COUNT];
+
+// the rest only with SIGALRM blocked
+static bool holdout[MAX_THREADS_COUNT];     // in a section when the grace period began
+static size_t holdout_count = 0;
+static bool gp_running = false;
+static bool gp_requested = false;           // a synchronize_rcu waits for the next one
+static unsigned long gp_started = 0;
+static unsigned long gp_completed = 0;
+
+static rcu_list_t next_batch;    // queued, waiting for a grace period to begin
+static rcu_list_t gp_batch;      // waiting for the running grace period to end
+static rcu_list_t done_batch;    // safe to run, handed to the reclaimer
+
+static unsigned long queued_callbacks = 0;
+static unsigned long done_callbacks = 0;
+
+// synchronize_rcu and rcu_barrier callers, they recheck their condition when woken
+static bool waiting_threads[MAX_THREADS_COUNT];
+static size_t waiting_count = 0;
+static bool reclaimer_started = false;
+static tid_t reclaimer;
+
+void ult_rcu_read_lock(void) {
+    nesting[ULT_TID_SLOT(ult_self())]++;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+void ult_rcu_read_unlock(void) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    nesting[ULT_TID_SLOT(ult_self())]--;
+}
+
+static void list_append(rcu_list_t *to, rcu_list_t *from) {
+    if (from->head == NULL) {
+        return;
+    }
+    if (to->head == NULL) {
+        to->head = from->head;
+    } else {
+        to->tail->next = from->head;
+    }
+    to->tail = from->tail;
+    from->head = from->tail = NULL;
+}
+
+static void wake_waiters(void) {
+    for (size_t i = 0; i < MAX_THREADS_COUNT && waiting_count > 0; i++) {
+        if (waiting_threads[i]) {
+            waiting_threads[i] = false;
+            waiting_count--;
+            ult_make_ready(get_thread_by_slot(i));
+        }
+    }
+}
+
+// block until woken by wake_waiters, signals must be blocked
+static void wait_once(size_t self) {
+    if (!waiting_threads[self]) {
+        waiting_threads[self] = true;
+        waiting_count++;
+    }
+    get_current_thread()->state = ULT_BLOCKED;
+    unblock_signals();
+    ult_yield();
+    block_signals();
+}
+
+// everything queued so far waits for the readers that are inside a section now
+static void start_grace_period(void) {
+    gp_running = true;
+    gp_requested = false;
+    gp_started++;
+    list_append(&gp_batch, &next_batch);
+
+    holdout_count = 0;
+    for (size_t i = 0; i < ult_get_thread_count(); i++) {
+        ult_t *t = get_thread_by_slot(i);
+        holdout[i] = nesting[i] > 0 && t->state != ULT_TERMINATED;
+        if (holdout[i]) {
+            holdout_count++;
+        }
+    }
+}
+
+static void end_grace_period(void) {
+    gp_running = false;
+    gp_completed = gp_started;
+
+    if (gp_batch.head != NULL) {
+        list_append(&done_batch, &gp_batch);
+        ult_make_ready(get_thread_by_id(reclaimer));
+    }
+    wake_waiters();
+}
+
+void ult_rcu_quiescent(ult_t *outgoing) {
+    size_t slot = ULT_TID_SLOT(outgoing->tid);
+
+    // a thread that exits inside a section can not hold references any more,
+    // and the next thread in its slot must not start inside one
+    if (outgoing->state == ULT_TERMINATED) {
+        nesting[slot] = 0;
+    }
+    if (!gp_running && !gp_requested && next_batch.head == NULL) {
+        return;
+    }
+
+    if (holdout[slot] && nesting[slot] == 0) {
+        holdout[slot] = false;
+        holdout_count--;
+    }
+
+    if (gp_running && holdout_count == 0) {
+        end_grace_period();
+    }
+    if (!gp_running && (gp_requested || next_batch.head != NULL)) {
+        start_grace_period();
+    }
+}
+
+static void *reclaim(void *arg) {
+    ult_t *current = get_current_thread();
+
+    for (;;) {
+        block_signals();
+        while (done_batch.head == NULL) {
+            current->state = ULT_BLOCKED;
+            unblock_signals();
+            ult_yield();
+            block_signals();
+        }
+        rcu_callback_t *cb = done_batch.head;
+        done_batch.head = done_batch.tail = NULL;
+        unblock_signals();
+
+        unsigned long count = 0;
+        while (cb != NULL) {
+            rcu_callback_t *next = cb->next;
+            cb->fn(cb->ptr);
+            free(cb);
+            cb = next;
+            count++;
+        }
+
+        block_signals();
+        done_callbacks += count;
+        wake_waiters();
+        unblock_signals();
+    }
+
+    return NULL;
+}
+
+int ult_call_rcu(void (*fn)(void *), void *ptr) {
+    if (!reclaimer_started) {
+        if (ult_create(&reclaimer, reclaim, NULL) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        ult_detach(reclaimer);
+        reclaimer_started = true;
+    }
+
+    rcu_callback_t *cb = malloc(sizeof(rcu_callback_t));
+    if (cb == NULL) {
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+    cb->next = NULL;
+    cb->fn = fn;
+    cb->ptr = ptr;
+
+    // the next switch starts a grace period for it if none is running
+    block_signals();
+    rcu_list_t one = {cb, cb};
+    list_append(&next_batch, &one);
+    queued_callbacks++;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+int ult_synchronize_rcu(void) {
+    block_signals();
+    size_t self = ULT_TID_SLOT(ult_self());
+
+    if (nesting[self] > 0) {
+        // would wait for itself
+        unblock_signals();
+        errno = EDEADLK;
+        return EXIT_FAILURE;
+    }
+
+    // a grace period that is already running may have started before our update
+    unsigned long target = gp_started + 1;
+    if (gp_running) {
+        gp_requested = true;
+    } else {
+        start_grace_period();
+    }
+
+    while (gp_completed < target) {
+        wait_once(self);
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_rcu_barrier(void) {
+    block_signals();
+    size_t self = ULT_TID_SLOT(ult_self());
+
+    if (nesting[self] > 0) {
+        unblock_signals();
+        errno = EDEADLK;
+        return EXIT_FAILURE;
+    }
+
+    // queued callbacks get a grace period on the next switch, the reclaimer wakes us
+    unsigned long target = queued_callbacks;
+    while (done_callbacks < target) {
+        wait_once(self);
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+unsigned long ult_rcu_get_grace_periods(void) {
+    return gp_completed;
+}
@@ -0,0 +1,27 @@
+#ifndef ULT_RCU_H
+#define ULT_RCU_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+// Read-copy-update for ULTs. Readers only bump a per-thread nesting counter.
+// A ULT that is switched out while outside any read-side section has passed a
+// quiescent state; a grace period ends once every ULT that was inside a
+// section when it started has passed one. Callbacks queued with ult_call_rcu
+// are run in batches, one grace period per batch, by a reclaimer ULT.
+
+// publish / read a pointer that readers follow inside a read-side section
+#define ult_rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define ult_rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+void ult_rcu_read_lock(void);
+void ult_rcu_read_unlock(void);
+int ult_call_rcu(void (*fn)(void *), void *ptr);
+int ult_synchronize_rcu(void);
+int ult_rcu_barrier(void);   // waits until every callback queued so far has run
+unsigned long ult_rcu_get_grace_periods(void);
+
+// scheduler side, SIGALRM must be blocked
+void ult_rcu_quiescent(ult_t *outgoing);
+
+#endif
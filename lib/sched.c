@@ -0,0 +1,373 @@
+#include "sched.h"
+#include "group.h"
+#include "utils.h"
+
+#include <stddef.h>
+
+// ---------- run queue heap ----------
+// Binary min-heap of threads ordered by ult_t.sched_key. Each thread remembers
+// its slot in sched_index so it can be removed from the middle in O(log n).
+
+typedef struct {
+    ult_t *items[MAX_THREADS_COUNT];
+    size_t size;
+} sched_heap_t;
+
+static void heap_swap(sched_heap_t *h, size_t a, size_t b) {
+    ult_t *t = h->items[a];
+    h->items[a] = h->items[b];
+    h->items[b] = t;
+    h->items[a]->sched_index = a;
+    h->items[b]->sched_index = b;
+}
+
+static void heap_up(sched_heap_t *h, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->items[parent]->sched_key <= h->items[i]->sched_key) {
+            break;
+        }
+        heap_swap(h, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_down(sched_heap_t *h, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < h->size && h->items[left]->sched_key < h->items[smallest]->sched_key) {
+            smallest = left;
+        }
+        if (right < h->size && h->items[right]->sched_key < h->items[smallest]->sched_key) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        heap_swap(h, i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_push(sched_heap_t *h, ult_t *t) {
+    t->sched_index = h->size;
+    h->items[h->size++] = t;
+    heap_up(h, t->sched_index);
+}
+
+static void heap_remove(sched_heap_t *h, size_t i) {
+    h->size--;
+    if (i != h->size) {
+        h->items[i] = h->items[h->size];
+        h->items[i]->sched_index = i;
+        heap_up(h, i);
+        heap_down(h, h->items[i]->sched_index);
+    }
+}
+
+static ult_t *heap_pop(sched_heap_t *h) {
+    if (h->size == 0) {
+        return NULL;
+    }
+    ult_t *t = h->items[0];
+    heap_remove(h, 0);
+    return t;
+}
+
+// ---------- round robin ----------
+
+static void rr_init(const ult_config_t *config) {}
+static void rr_enqueue(ult_t *t) {}
+static void rr_dequeue(ult_t *t) {}
+static void rr_on_tick(ult_t *current, uint64_t ran_ns) {}
+static void rr_on_block(ult_t *t) {}
+
+// first ready thread after the current one, in thread table order
+static ult_t *rr_pick_next(ult_t *current) {
+    size_t count = ult_get_thread_count();
+    size_t i = ULT_TID_SLOT(current->tid);
+    for (size_t checked = 0; checked < count; checked++) {
+        // wrap by hand, a modulo per entry costs more than the load of its state
+        if (++i == count) {
+            i = 0;
+        }
+        ult_t *t = get_thread_by_slot(i);
+        if (t->state == ULT_READY) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+const ult_sched_ops_t ult_sched_rr = {
+    .name = "rr",
+    .init = rr_init,
+    .enqueue = rr_enqueue,
+    .dequeue = rr_dequeue,
+    .pick_next = rr_pick_next,
+    .on_tick = rr_on_tick,
+    .on_block = rr_on_block,
+};
+
+// ---------- fair ----------
+// Runnable threads are keyed by virtual runtime. A thread that slept is placed
+// at most `wakeup_credit` behind the minimum, so it runs soon after waking but
+// cannot bank credit for the time it was blocked.
+
+static sched_heap_t fair_queue;
+static uint64_t min_vruntime = 0;
+static uint64_t wakeup_credit = 0;
+
+static void fair_init(const ult_config_t *config) {
+    fair_queue.size = 0;
+    min_vruntime = 0;
+    wakeup_credit = (uint64_t)config->quantum * 1000 / 2;
+}
+
+static void fair_enqueue(ult_t *t) {
+    uint64_t floor = min_vruntime > wakeup_credit ? min_vruntime - wakeup_credit : 0;
+    if (t->vruntime < floor) {
+        t->vruntime = floor;
+    }
+    t->sched_key = t->vruntime;
+    heap_push(&fair_queue, t);
+}
+
+static void fair_dequeue(ult_t *t) {
+    heap_remove(&fair_queue, t->sched_index);
+}
+
+static ult_t *fair_pick_next(ult_t *current) {
+    ult_t *next = heap_pop(&fair_queue);
+    if (next != NULL && next->vruntime > min_vruntime) {
+        min_vruntime = next->vruntime;
+    }
+    return next;
+}
+
+static void fair_on_tick(ult_t *current, uint64_t ran_ns) {
+    current->vruntime += ran_ns;
+}
+
+static void fair_on_block(ult_t *t) {}
+
+const ult_sched_ops_t ult_sched_fair = {
+    .name = "fair",
+    .init = fair_init,
+    .enqueue = fair_enqueue,
+    .dequeue = fair_dequeue,
+    .pick_next = fair_pick_next,
+    .on_tick = fair_on_tick,
+    .on_block = fair_on_block,
+};
+
+// ---------- earliest deadline first ----------
+// Threads with a deadline are keyed by it and always run before best-effort
+// threads, which are served in FIFO order (keyed by arrival).
+
+static sched_heap_t edf_deadline_queue;
+static sched_heap_t edf_best_effort_queue;
+static uint64_t edf_arrival = 0;
+
+static void edf_init(const ult_config_t *config) {
+    edf_deadline_queue.size = 0;
+    edf_best_effort_queue.size = 0;
+}
+
+static void edf_enqueue(ult_t *t) {
+    if (t->deadline != 0) {
+        t->sched_key = t->deadline;
+        heap_push(&edf_deadline_queue, t);
+    } else {
+        t->sched_key = edf_arrival++;
+        heap_push(&edf_best_effort_queue, t);
+    }
+}
+
+static void edf_dequeue(ult_t *t) {
+    // find out which of the two heaps holds the thread
+    sched_heap_t *h = &edf_best_effort_queue;
+    if (t->sched_index < edf_deadline_queue.size &&
+        edf_deadline_queue.items[t->sched_index] == t) {
+        h = &edf_deadline_queue;
+    }
+    heap_remove(h, t->sched_index);
+}
+
+static ult_t *edf_pick_next(ult_t *current) {
+    ult_t *next = heap_pop(&edf_deadline_queue);
+    if (next == NULL) {
+        next = heap_pop(&edf_best_effort_queue);
+    }
+    return next;
+}
+
+static void edf_on_tick(ult_t *current, uint64_t ran_ns) {}
+static void edf_on_block(ult_t *t) {}
+
+static bool edf_should_preempt(ult_t *woken, ult_t *current) {
+    if (woken->deadline == 0) {
+        return false;
+    }
+    return current->deadline == 0 || woken->deadline < current->deadline;
+}
+
+const ult_sched_ops_t ult_sched_edf = {
+    .name = "edf",
+    .init = edf_init,
+    .enqueue = edf_enqueue,
+    .dequeue = edf_dequeue,
+    .pick_next = edf_pick_next,
+    .on_tick = edf_on_tick,
+    .on_block = edf_on_block,
+    .should_preempt = edf_should_preempt,
+};
+
+// ---------- static priorities ----------
+// Highest effective priority first. The key puts the inverted priority above an
+// arrival counter, so equal priorities are served in FIFO order and a thread
+// requeued at the end of its timeslice goes behind its peers.
+
+#define PRIO_ARRIVAL_BITS 48
+
+static sched_heap_t prio_queue;
+static uint64_t prio_arrival = 0;
+
+static void prio_init(const ult_config_t *config) {
+    prio_queue.size = 0;
+}
+
+static void prio_enqueue(ult_t *t) {
+    uint64_t level = (uint64_t)(ULT_PRIO_MAX - t->priority);
+    t->sched_key = (level << PRIO_ARRIVAL_BITS) |
+                   (prio_arrival++ & ((1ULL << PRIO_ARRIVAL_BITS) - 1));
+    heap_push(&prio_queue, t);
+}
+
+static void prio_dequeue(ult_t *t) {
+    heap_remove(&prio_queue, t->sched_index);
+}
+
+static ult_t *prio_pick_next(ult_t *current) {
+    return heap_pop(&prio_queue);
+}
+
+static void prio_on_tick(ult_t *current, uint64_t ran_ns) {}
+static void prio_on_block(ult_t *t) {}
+
+static bool prio_should_preempt(ult_t *woken, ult_t *current) {
+    return woken->priority > current->priority;
+}
+
+const ult_sched_ops_t ult_sched_prio = {
+    .name = "prio",
+    .init = prio_init,
+    .enqueue = prio_enqueue,
+    .dequeue = prio_dequeue,
+    .pick_next = prio_pick_next,
+    .on_tick = prio_on_tick,
+    .on_block = prio_on_block,
+    .should_preempt = prio_should_preempt,
+};
+
+// ---------- groups ----------
+// Two levels: the runnable group with the lowest weighted virtual runtime goes
+// first, then its threads are served in FIFO order, so a group's share does not
+// depend on how many threads it has. A group that used up its quota is skipped
+// until its next period starts.
+
+static sched_heap_t group_queues[ULT_MAX_GROUPS];
+static uint64_t group_arrival = 0;
+static uint64_t group_min_vruntime = 0;
+static uint64_t group_wakeup_credit = 0;
+
+static void group_init(const ult_config_t *config) {
+    for (size_t i = 0; i < ULT_MAX_GROUPS; i++) {
+        group_queues[i].size = 0;
+    }
+    group_min_vruntime = 0;
+    group_wakeup_credit = (uint64_t)config->quantum * 1000 / 2;
+}
+
+static void group_enqueue(ult_t *t) {
+    sched_heap_t *q = &group_queues[t->group];
+
+    // an idle group comes back just behind the others, without banked credit
+    if (q->size == 0) {
+        ult_group_t *g = get_group_by_id(t->group);
+        uint64_t floor = group_min_vruntime > group_wakeup_credit ?
+                         group_min_vruntime - group_wakeup_credit : 0;
+        if (g->vruntime < floor) {
+            g->vruntime = floor;
+        }
+    }
+
+    t->sched_key = group_arrival++;
+    heap_push(q, t);
+}
+
+static void group_dequeue(ult_t *t) {
+    heap_remove(&group_queues[t->group], t->sched_index);
+}
+
+static ult_t *group_pick_next(ult_t *current) {
+    uint64_t now = now_ns();
+    ult_group_t *best = NULL;
+
+    for (grpid_t gid = 0; gid < ult_get_group_count(); gid++) {
+        if (group_queues[gid].size == 0) {
+            continue;
+        }
+        ult_group_t *g = get_group_by_id(gid);
+        if (ult_group_is_throttled(g, now)) {
+            continue;
+        }
+        if (best == NULL || g->vruntime < best->vruntime) {
+            best = g;
+        }
+    }
+
+    if (best == NULL) {
+        return NULL;
+    }
+    if (best->vruntime > group_min_vruntime) {
+        group_min_vruntime = best->vruntime;
+    }
+    return heap_pop(&group_queues[best->id]);
+}
+
+static void group_on_tick(ult_t *current, uint64_t ran_ns) {
+    ult_group_t *g = get_group_by_id(current->group);
+    g->vruntime += ran_ns * ULT_GROUP_DEFAULT_WEIGHT / g->weight;
+}
+
+static void group_on_block(ult_t *t) {}
+
+// start of the next period of the first throttled group that has runnable threads
+static uint64_t group_next_wakeup(void) {
+    uint64_t earliest = 0;
+    for (grpid_t gid = 0; gid < ult_get_group_count(); gid++) {
+        ult_group_t *g = get_group_by_id(gid);
+        if (group_queues[gid].size == 0 || g == NULL || !g->throttled_now) {
+            continue;
+        }
+        uint64_t period_end = g->period_start + g->period_ns;
+        if (earliest == 0 || period_end < earliest) {
+            earliest = period_end;
+        }
+    }
+    return earliest;
+}
+
+const ult_sched_ops_t ult_sched_group = {
+    .name = "group",
+    .init = group_init,
+    .enqueue = group_enqueue,
+    .dequeue = group_dequeue,
+    .pick_next = group_pick_next,
+    .on_tick = group_on_tick,
+    .on_block = group_on_block,
+    .next_wakeup = group_next_wakeup,
+};
@@ -0,0 +1,32 @@
+#ifndef ULT_SCHED_H
+#define ULT_SCHED_H
+
+#include "ult.h"
+
+// A scheduling policy. The core calls these with SIGALRM blocked:
+// - enqueue/dequeue when a thread enters/leaves the runnable set (never twice in a row)
+// - on_tick for the outgoing thread with the time it just spent on the CPU
+// - on_block when the outgoing thread blocked
+// - pick_next to choose (and remove from the queue) the next thread, NULL if none
+// - should_preempt (optional) when a thread wakes up while another one runs
+// - next_wakeup (optional) when pick_next held back runnable threads: the time they
+//   become eligible again, so the scheduler idles instead of reporting a deadlock
+typedef struct ult_sched_ops {
+    const char *name;
+    void (*init)(const ult_config_t *config);
+    void (*enqueue)(ult_t *t);
+    void (*dequeue)(ult_t *t);
+    ult_t *(*pick_next)(ult_t *current);
+    void (*on_tick)(ult_t *current, uint64_t ran_ns);
+    void (*on_block)(ult_t *t);
+    bool (*should_preempt)(ult_t *woken, ult_t *current);
+    uint64_t (*next_wakeup)(void);
+} ult_sched_ops_t;
+
+extern const ult_sched_ops_t ult_sched_rr;     // round robin over the thread table
+extern const ult_sched_ops_t ult_sched_fair;   // lowest virtual runtime first
+extern const ult_sched_ops_t ult_sched_edf;    // earliest deadline first, then best effort
+extern const ult_sched_ops_t ult_sched_prio;   // highest priority first, round robin among equals
+extern const ult_sched_ops_t ult_sched_group;  // weighted fair share between groups, with quotas
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ULT_SDT_H
+#define ULT_SDT_H
+
+// Stand-in for <sys/sdt.h> when the systemtap headers are not installed. It
+// writes the same .note.stapsdt records, so bpftrace, perf and stap find the
+// probes, but only on x86-64 and without semaphores; elsewhere the probes
+// compile to nothing. Every argument is recorded as a signed 64 bit value.
+
+#if defined(__x86_64__)
+
+#define _ULT_SDT_NOTE(provider, name, args)                                   \
+    "990: nop\n"                                                            \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                           \
+    ".balign 4\n"                                                           \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                      \
+    "991: .asciz \"stapsdt\"\n"                                             \
+    "992: .balign 4\n"                                                      \
+    "993: .8byte 990b\n"                                                    \
+    ".8byte _.stapsdt.base\n"                                               \
+    ".8byte 0\n"                                                            \
+    ".asciz \"" #provider "\"\n"                                            \
+    ".asciz \"" #name "\"\n"                                                \
+    ".asciz \"" args "\"\n"                                                 \
+    "994: .balign 4\n"                                                      \
+    ".popsection\n"                                                         \
+    ".ifndef _.stapsdt.base\n"                                              \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n"                                                \
+    ".hidden _.stapsdt.base\n"                                              \
+    "_.stapsdt.base: .space 1\n"                                            \
+    ".size _.stapsdt.base, 1\n"                                             \
+    ".popsection\n"                                                         \
+    ".endif\n"
+
+// "nor": the argument stays wherever it already is, the probe itself is a nop
+#define STAP_PROBE(provider, name) \
+    __asm__ __volatile__(_ULT_SDT_NOTE(provider, name, ""))
+#define STAP_PROBE1(provider, name, a1) \
+    __asm__ __volatile__(_ULT_SDT_NOTE(provider, name, "-8@%0") :: "nor"((long)(a1)))
+#define STAP_PROBE2(provider, name, a1, a2)                                   \
+    __asm__ __volatile__(_ULT_SDT_NOTE(provider, name, "-8@%0 -8@%1")       \
+                         :: "nor"((long)(a1)), "nor"((long)(a2)))
+#define STAP_PROBE3(provider, name, a1, a2, a3)                               \
+    __asm__ __volatile__(_ULT_SDT_NOTE(provider, name, "-8@%0 -8@%1 -8@%2") \
+                         :: "nor"((long)(a1)), "nor"((long)(a2)), "nor"((long)(a3)))
+
+#else
+
+#define STAP_PROBE(provider, name) do { } while (0)
+#define STAP_PROBE1(provider, name, a1) do { (void)(a1); } while (0)
+#define STAP_PROBE2(provider, name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define STAP_PROBE3(provider, name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+
+#endif
+
+#endif
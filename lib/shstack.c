@@ -0,0 +1,201 @@
+#define _GNU_SOURCE
+#include "shstack.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SWITCHER_STACK_SIZE (64 * 1024)
+#define RED_ZONE 128                  // below the saved stack pointer, still live on x86-64
+
+// Copy buffers come from size classes (multiples of COPY_GRANULE) carved out of
+// mmap'd chunks: the switcher runs inside the SIGALRM handler, where malloc may
+// be interrupted halfway by the preempted thread.
+#define COPY_GRANULE 256
+#define COPY_CLASSES 64               // up to 16KB, deeper copies get their own mapping
+#define COPY_CHUNK (64 * 1024)
+
+typedef struct copy_block {
+    struct copy_block *next;
+} copy_block_t;
+
+static copy_block_t *free_blocks[COPY_CLASSES];
+static size_t reserved_bytes = 0;
+static size_t saved_bytes = 0;
+
+static ucontext_t switcher_context;
+static bool switcher_ready = false;
+static ult_t *switch_to = NULL;
+static void (*thread_entry)(void) = NULL;
+
+static int copy_class(size_t size) {
+    size_t k = (size + COPY_GRANULE - 1) / COPY_GRANULE - 1;
+    return k < COPY_CLASSES ? (int)k : COPY_CLASSES;
+}
+
+static void *map(size_t size) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("Failed to map stack copy");
+        abort();
+    }
+    reserved_bytes += size;
+    return p;
+}
+
+static void *copy_alloc(size_t size, size_t *capacity) {
+    int k = copy_class(size);
+    if (k == COPY_CLASSES) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        *capacity = (size + page - 1) / page * page;
+        return map(*capacity);
+    }
+
+    size_t block = (size_t)(k + 1) * COPY_GRANULE;
+    if (free_blocks[k] == NULL) {
+        size_t chunk = COPY_CHUNK - COPY_CHUNK % block;
+        char *p = map(chunk);
+        for (size_t off = 0; off < chunk; off += block) {
+            copy_block_t *b = (copy_block_t *)(p + off);
+            b->next = free_blocks[k];
+            free_blocks[k] = b;
+        }
+    }
+
+    copy_block_t *b = free_blocks[k];
+    free_blocks[k] = b->next;
+    *capacity = block;
+    return b;
+}
+
+static void copy_free(void *p, size_t capacity) {
+    int k = copy_class(capacity);
+    if (k == COPY_CLASSES) {
+        munmap(p, capacity);
+        reserved_bytes -= capacity;
+        return;
+    }
+    copy_block_t *b = p;
+    b->next = free_blocks[k];
+    free_blocks[k] = b;
+}
+
+// live part of the stack of t, from its saved stack pointer to the top
+static size_t live_depth(ult_t *t, ult_shared_stack_t *s) {
+    char *sp = (char *)t->cold->context.uc_mcontext.gregs[REG_RSP] - RED_ZONE;
+    if (sp < s->base || sp >= s->base + s->size) {
+        // preempted on another stack (a coroutine), keep everything
+        return s->size;
+    }
+    return s->base + s->size - sp;
+}
+
+static void save_stack(ult_t *t, ult_shared_stack_t *s) {
+    size_t depth = live_depth(t, s);
+    if (t->cold->stack_copy_capacity < depth) {
+        if (t->cold->stack_copy != NULL) {
+            copy_free(t->cold->stack_copy, t->cold->stack_copy_capacity);
+        }
+        t->cold->stack_copy = copy_alloc(depth, &t->cold->stack_copy_capacity);
+    }
+    memcpy(t->cold->stack_copy, s->base + s->size - depth, depth);
+    saved_bytes += depth - t->cold->stack_copy_size;
+    t->cold->stack_copy_size = depth;
+}
+
+static void restore_stack(ult_t *t, ult_shared_stack_t *s) {
+    memcpy(s->base + s->size - t->cold->stack_copy_size, t->cold->stack_copy, t->cold->stack_copy_size);
+    saved_bytes -= t->cold->stack_copy_size;
+    t->cold->stack_copy_size = 0;
+}
+
+static void switcher(void) {
+    for (;;) {
+        ult_t *next = switch_to;
+        ult_shared_stack_t *s = next->cold->shared_stack;
+        ult_t *owner = s->owner;
+
+        // nothing to keep for a thread that exited or has not started yet
+        if (owner != NULL && owner != next && owner->cold->shared_stack == s &&
+            owner->state != ULT_TERMINATED && !owner->cold->stack_fresh) {
+            save_stack(owner, s);
+        }
+
+        if (next->cold->stack_fresh) {
+            next->cold->stack_fresh = false;
+            makecontext(&next->cold->context, thread_entry, 0);
+        } else if (owner != next) {
+            restore_stack(next, s);
+        }
+        s->owner = next;
+
+        swapcontext(&switcher_context, &next->cold->context);
+    }
+}
+
+ult_shared_stack_t *ult_shstack_create(size_t size) {
+    if (!switcher_ready) {
+        if (getcontext(&switcher_context) == -1) {
+            return NULL;
+        }
+        if (ult_make_context(&switcher_context, NULL, NULL, switcher) != EXIT_SUCCESS) {
+            return NULL;
+        }
+        // the switcher must never be preempted
+        sigaddset(&switcher_context.uc_sigmask, SIGALRM);
+        switcher_ready = true;
+    }
+
+    ult_shared_stack_t *s = malloc(sizeof(ult_shared_stack_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (s->base == MAP_FAILED) {
+        free(s);
+        return NULL;
+    }
+    s->size = size;
+    s->owner = NULL;
+    return s;
+}
+
+// no thread of the stack may be alive
+void ult_shstack_destroy(ult_shared_stack_t *s) {
+    munmap(s->base, s->size);
+    free(s);
+}
+
+void ult_shstack_get_usage(size_t *reserved, size_t *saved) {
+    block_signals();
+    *reserved = reserved_bytes;
+    *saved = saved_bytes;
+    unblock_signals();
+}
+
+void ult_shstack_prepare(ult_t *t, ult_shared_stack_t *s, ucontext_t *link, void (*entry)(void)) {
+    t->cold->shared_stack = s;
+    t->cold->stack_fresh = true;
+    t->cold->stack_copy_size = 0;
+    t->cold->context.uc_stack.ss_sp = s->base;
+    t->cold->context.uc_stack.ss_size = s->size;
+    t->cold->context.uc_stack.ss_flags = 0;
+    t->cold->context.uc_link = link;
+    thread_entry = entry;
+}
+
+void ult_shstack_switch(ult_t *current, ult_t *next) {
+    ult_shared_stack_t *s = next->cold->shared_stack;
+    if (s->owner == next && !next->cold->stack_fresh) {
+        // its frames are still in place
+        swapcontext(&current->cold->context, &next->cold->context);
+        return;
+    }
+
+    switch_to = next;
+    swapcontext(&current->cold->context, &switcher_context);
+}
@@ -0,0 +1,31 @@
+#ifndef ULT_SHSTACK_H
+#define ULT_SHSTACK_H
+
+#include "ult.h"
+
+// Shared stacks: the threads of a group run one at a time on a single large
+// stack. When another thread of the group needs it, the frames of the thread
+// that used it last are copied out to a buffer sized to their depth, and
+// copied back before that thread runs again. The copies are made on a small
+// private switcher stack, with SIGALRM blocked.
+
+typedef struct ult_shared_stack {
+    char *base;
+    size_t size;
+    ult_t *owner;          // thread whose frames are on the stack, NULL if none
+} ult_shared_stack_t;
+
+ult_shared_stack_t *ult_shstack_create(size_t size);
+void ult_shstack_destroy(ult_shared_stack_t *s);
+
+// bytes reserved for parked stack copies, and bytes actually copied out
+void ult_shstack_get_usage(size_t *reserved, size_t *saved);
+
+// set up a new thread on a shared stack, its first frame is built lazily
+void ult_shstack_prepare(ult_t *t, ult_shared_stack_t *s, ucontext_t *link, void (*entry)(void));
+
+// scheduler side, SIGALRM must be blocked: save current and resume next, which
+// runs on a shared stack
+void ult_shstack_switch(ult_t *current, ult_t *next);
+
+#endif
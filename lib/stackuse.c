@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include "stackuse.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAINT_PATTERN 0x5a5a5a5a5a5a5a5aULL
+#define PAINT_SKIP 64   // the huge page arena keeps its canary in the lowest bytes
+
+static bool enabled = false;
+static bool adaptive = false;
+static ult_stack_usage_t routines[ULT_STACK_ROUTINES];
+static size_t routine_count = 0;
+static size_t signal_frame = 0;
+
+// open addressing on the routine's address, NULL if it is not tracked (and the table is full)
+static ult_stack_usage_t *find(void *(*routine)(void *), bool insert) {
+    size_t start = ((uintptr_t)routine >> 4) % ULT_STACK_ROUTINES;
+    for (size_t i = 0; i < ULT_STACK_ROUTINES; i++) {
+        ult_stack_usage_t *e = &routines[(start + i) % ULT_STACK_ROUTINES];
+        if (e->routine == routine) {
+            return e;
+        }
+        if (NULL == e->routine) {
+            if (!insert) {
+                return NULL;
+            }
+            e->routine = routine;
+            routine_count++;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+int ult_stack_usage_enable(bool adaptive_sizes) {
+    block_signals();
+    memset(routines, 0, sizeof(routines));
+    routine_count = 0;
+    signal_frame = 0;
+    adaptive = adaptive_sizes;
+    enabled = true;
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+void ult_stack_usage_disable(void) {
+    enabled = false;
+    adaptive = false;
+}
+
+bool ult_stack_usage_enabled(void) {
+    return enabled;
+}
+
+size_t ult_stack_usage_get(ult_stack_usage_t *usage, size_t max) {
+    block_signals();
+    size_t n = 0;
+    for (size_t i = 0; i < ULT_STACK_ROUTINES && n < max; i++) {
+        if (NULL != routines[i].routine) {
+            usage[n++] = routines[i];
+        }
+    }
+    unblock_signals();
+    return n;
+}
+
+size_t ult_stack_signal_frame(void) {
+    return signal_frame;
+}
+
+void ult_stack_note_signal(ult_t *t, const ucontext_t *interrupted, const void *handler_frame) {
+    const char *sp = (const char *)interrupted->uc_mcontext.gregs[REG_RSP];
+    size_t frame = sp - (const char *)handler_frame;
+    if (frame > signal_frame && frame < ULT_STACK_MAX) {
+        signal_frame = frame;
+    }
+
+    // how deep the thread itself was, kept apart from the frames the tick adds
+    const char *top = (const char *)t->cold->stack + t->cold->stack_size;
+    if (t->cold->stack_painted && sp > (const char *)t->cold->stack && sp <= top &&
+        (size_t)(top - sp) > t->cold->preempt_depth) {
+        t->cold->preempt_depth = top - sp;
+    }
+}
+
+size_t ult_stack_round(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+size_t ult_stack_size_for(void *(*routine)(void *)) {
+    if (!adaptive || NULL == routine) {
+        return 0;
+    }
+    ult_stack_usage_t *e = find(routine, false);
+    return NULL != e ? e->stack_size : 0;
+}
+
+void ult_stack_paint(void *stack, size_t size) {
+    uint64_t *word = (uint64_t *)((char *)stack + PAINT_SKIP);
+    uint64_t *end = (uint64_t *)((char *)stack + size);
+    while (word < end) {
+        *word++ = PAINT_PATTERN;
+    }
+}
+
+void ult_stack_measure(void *(*routine)(void *), const void *stack, size_t size, size_t preempt_depth) {
+    const uint64_t *bottom = (const uint64_t *)((const char *)stack + PAINT_SKIP);
+    const uint64_t *end = (const uint64_t *)((const char *)stack + size);
+    const uint64_t *word = bottom;
+    while (word < end && PAINT_PATTERN == *word) {
+        word++;
+    }
+    size_t used = (const char *)end - (const char *)word;
+
+    ult_stack_usage_t *e = find(routine, true);
+    if (NULL == e) {
+        return;
+    }
+    e->threads++;
+    e->total_used += used;
+    if (used > e->max_used) {
+        e->max_used = used;
+    }
+    if (preempt_depth > e->max_preempted) {
+        e->max_preempted = preempt_depth;
+    }
+
+    // a tick puts its SIGALRM frame below the depth it interrupts. The marks of
+    // interrupted threads already hold that frame, so it is only added to the
+    // depths ticks were seen at, or to the mark of a routine never interrupted
+    size_t tick_depth = (0 != e->max_preempted ? e->max_preempted : e->max_used) + signal_frame;
+    size_t need = e->max_used > tick_depth ? e->max_used : tick_depth;
+    size_t next = ult_stack_round(need + ULT_STACK_MARGIN);
+    if (word == bottom) {
+        e->exhausted++;
+        if (2 * size > next) {
+            next = 2 * size;
+        }
+    }
+    if (next < e->stack_size) {
+        next = e->stack_size;   // never shrink below a size that had to grow
+    }
+    e->stack_size = next < ULT_STACK_MAX ? next : ULT_STACK_MAX;
+}
@@ -0,0 +1,49 @@
+#ifndef ULT_STACKUSE_H
+#define ULT_STACKUSE_H
+
+#include "ult.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <ucontext.h>
+
+// Stack high-water marks per start routine. While enabled, every new private
+// stack is painted with a pattern, and when its thread exits the lowest word
+// overwritten tells how deep it went. The SIGALRM handler also records how deep
+// each thread was when a tick interrupted it. In adaptive mode the next threads
+// of a routine get, instead of the configured size, whichever is deeper: its
+// deepest mark, or its deepest interrupted point plus the largest SIGALRM frame
+// seen so far (its size depends on the CPU's vector state). ULT_STACK_MARGIN
+// is added for the scheduler and the size rounded up to whole pages. A mark at
+// the very bottom means the stack was too small, and probably overflowed: the
+// routine's next stacks are twice as large, up to ULT_STACK_MAX. Stacks of the
+// huge page arena keep their fixed size, shared stacks are not measured.
+
+#define ULT_STACK_ROUTINES 64     // start routines tracked, later ones are not
+#define ULT_STACK_MARGIN 1024
+#define ULT_STACK_MAX (64 * 1024)
+
+typedef struct {
+    void *(*routine)(void *);
+    unsigned long threads;        // exited threads measured
+    size_t max_used;              // deepest mark, bytes
+    size_t max_preempted;         // deepest point a tick interrupted, bytes, 0 if none did
+    size_t total_used;            // sum of the marks, for the mean
+    unsigned long exhausted;      // threads that reached the bottom of their stack
+    size_t stack_size;            // given to the routine's next threads in adaptive mode
+} ult_stack_usage_t;
+
+int ult_stack_usage_enable(bool adaptive);
+void ult_stack_usage_disable(void);
+bool ult_stack_usage_enabled(void);
+size_t ult_stack_usage_get(ult_stack_usage_t *usage, size_t max);
+size_t ult_stack_signal_frame(void);   // largest SIGALRM frame seen, bytes
+
+// thread side, SIGALRM must be blocked. 0 when the routine has no history yet
+size_t ult_stack_size_for(void *(*routine)(void *));
+size_t ult_stack_round(size_t size);   // up to whole pages
+void ult_stack_paint(void *stack, size_t size);
+void ult_stack_measure(void *(*routine)(void *), const void *stack, size_t size, size_t preempt_depth);
+// from the SIGALRM handler: the frame sits between the interrupted stack pointer and the handler
+void ult_stack_note_signal(ult_t *t, const ucontext_t *interrupted, const void *handler_frame);
+
+#endif
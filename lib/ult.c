@@ -1,11 +1,26 @@
 #include "ult.h"
 #include "utils.h"
 #include "mutex.h"
+#include "inbox.h"
+#include "sched.h"
+#include "group.h"
+#include "perf.h"
+#include "rcu.h"
+#include "shstack.h"
+#include "hugepage.h"
+#include "watchdog.h"
+#include "profile.h"
+#include "arena.h"
+#include "probes.h"
+#include "stackuse.h"
 
 #include <string.h>
+#include <sys/mman.h>
 #include <signal.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <time.h>
+#include <assert.h>
 #include "errno.h"
 
 #define STOPSIG SIGALRM
@@ -16,44 +31,398 @@ struct sigaction alarm;
 static size_t thread_count = 0;
 static ult_t *running = NULL;
 static ucontext_t *main_context;
-static ult_t threads_list[MAX_THREADS_COUNT];
+static ult_t default_threads[MAX_THREADS_COUNT];
+static ult_t *threads_list = default_threads; // moved into the huge page arena if enabled
+static ult_cold_t default_cold[MAX_THREADS_COUNT];
+static ult_cold_t *cold_list = default_cold;  // contexts and stacks, indexed like threads_list
+static size_t timed_count = 0; // threads with a pending wake_at
+static tid_t free_slots[MAX_THREADS_COUNT]; // reaped slots, reused by the next create
+static size_t free_count = 0;
+static const ult_sched_ops_t *policy = &ult_sched_rr;
+static bool in_scheduler = false;
+static bool handoff_enabled = false; // signal and unlock yield to the thread they wake
+static ult_t *handoff = NULL;        // runs next instead of the policy's pick, see ult_yield_to
+static ult_t *lender = NULL;         // gave the rest of its timeslice to borrower, until the next tick
+static ult_t *borrower = NULL;
+static unsigned long total_deadline_misses = 0;
+static size_t stack_size = SIGSTKSZ; // private stacks without an adaptive size
+
+// one mapping carved into the stacks of a ult_create_many batch, unmapped with the last of them
+typedef struct ult_stack_batch
+{
+  void *base;
+  size_t length;
+  size_t stacks;
+} ult_stack_batch_t;
 
-ult_t *init_next_ult(state_t state)
+#define ULT_JOIN_ANY ((tid_t)-2) // waiting_for value of a thread blocked in ult_join_any
+#define ULT_WAIT_ANY ((tid_t)-3) // waiting_for value of a thread that claimed joins in ult_wait_any
+
+// take the next free slot and reset its state, the context is left to the caller
+static ult_t *take_slot(state_t state)
 {
-  ult_t *t = &threads_list[thread_count];
-  t->tid = thread_count;
+  ult_t *t;
+  if (free_count > 0)
+  {
+    // recycle a reaped slot, its stack is kept for the new thread
+    t = &threads_list[free_slots[--free_count]];
+    t->tid += ULT_TID_GENERATION;  // tids of the slot's earlier threads no longer match
+  }
+  else
+  {
+    t = &threads_list[thread_count];
+    t->tid = thread_count;
+    t->cold = &cold_list[thread_count];
+    t->cold->stack = NULL;
+    t->cold->stack_size = 0;
+    t->cold->stack_owned = false;
+    t->cold->stack_batch = NULL;
+    t->cold->stack_copy = NULL;
+    t->cold->stack_copy_capacity = 0;
+    thread_count++;
+  }
+
   t->state = state;
   t->waiting_for = -1;
   t->has_joiner = false;
   t->joiner = -1;
+  t->wake_at = 0;
+  t->detached = false;
+  t->released = false;
+  t->queued = false;
+  t->vruntime = 0;
+  t->cold->runtime_ns = 0;
+  t->switched_in = 0;
+  t->deadline = 0;
+  t->deadline_counted = false;
+  t->cold->deadline_misses = 0;
+  t->base_priority = ULT_PRIO_DEFAULT;
+  t->priority = ULT_PRIO_DEFAULT;
+  t->blocked_on = -1;
+  t->held_mutexes = -1;
+  t->parked = false;
+  t->permit = false;
+  t->cold->blocker = NULL;
+  t->group = ULT_GROUP_ROOT;
+  memset(t->cold->perf_counts, 0, sizeof(t->cold->perf_counts));
+  t->cold->shared_stack = NULL;
+  t->cold->stack_fresh = false;
+  t->cold->stack_copy_size = 0;
+  t->cold->stack_painted = false;
+
+  ULT_PROBE_CREATE(t->tid, NULL != running ? running->tid : (tid_t)-1);
+  return t;
+}
+
+ult_t *init_next_ult(state_t state)
+{
+  ult_t *t = take_slot(state);
 
-  if (getcontext(&t->context) == -1)
+  if (getcontext(&t->cold->context) == -1)
   {
     perror("Failed to get context");
     exit(EXIT_FAILURE);
   }
-  thread_count++;
 
   return t;
 }
 
+// give a terminated thread's slot (and stack) back for reuse, signals must be blocked
+static void release_thread(ult_t *t)
+{
+  // on the free list twice, the slot would be handed to two live threads
+  assert(!t->released);
+  if (t->released)
+  {
+    return;
+  }
+  t->released = true;
+  t->detached = true; // a reaped slot can no longer be joined
+  free_slots[free_count++] = ULT_TID_SLOT(t->tid);
+}
+
+// the thread tid names, NULL if it is out of range or its slot was taken by a newer thread
+static ult_t *lookup(tid_t tid)
+{
+  size_t slot = ULT_TID_SLOT(tid);
+  if (slot >= thread_count || threads_list[slot].tid != tid)
+  {
+    return NULL;
+  }
+  return &threads_list[slot];
+}
+
+void ult_set_timeout(ult_t *t, uint64_t deadline_ns)
+{
+  if (0 == t->wake_at)
+  {
+    timed_count++;
+  }
+  t->wake_at = deadline_ns;
+}
+
+static void sched_enqueue(ult_t *t)
+{
+  if (!t->queued)
+  {
+    t->queued = true;
+    policy->enqueue(t);
+  }
+}
+
+static void sched_dequeue(ult_t *t)
+{
+  if (t->queued)
+  {
+    t->queued = false;
+    policy->dequeue(t);
+  }
+}
+
+void ult_make_ready(ult_t *t)
+{
+  if (t->state == ULT_TERMINATED)
+  {
+    return;
+  }
+
+  if (t->state == ULT_BLOCKED)
+  {
+    ULT_PROBE_UNBLOCK(t->tid);
+  }
+  t->state = ULT_READY;
+  // the running thread is queued by the scheduler when it switches out
+  if (t != running)
+  {
+    sched_enqueue(t);
+
+    // a more urgent thread woke up: reschedule as soon as signals are unblocked
+    if (!in_scheduler && NULL != policy->should_preempt && policy->should_preempt(t, running))
+    {
+      raise(STOPSIG);
+    }
+  }
+}
+
+// record a miss once per deadline, signals must be blocked
+static void check_deadline(ult_t *t, uint64_t now)
+{
+  if (0 != t->deadline && !t->deadline_counted && now > t->deadline)
+  {
+    t->deadline_counted = true;
+    t->cold->deadline_misses++;
+    total_deadline_misses++;
+  }
+}
+
+int ult_set_deadline(tid_t tid, long usec)
+{
+  block_signals();
+
+  ult_t *t = lookup(tid);
+  if (NULL == t || t->state == ULT_TERMINATED)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  uint64_t now = now_ns();
+
+  // setting a new deadline (or clearing it) closes the previous one
+  check_deadline(t, now);
+
+  bool queued = t->queued;
+  sched_dequeue(t);
+  t->deadline = usec > 0 ? now + (uint64_t)usec * 1000 : 0;
+  t->deadline_counted = false;
+  if (queued)
+  {
+    sched_enqueue(t);
+  }
+
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
+unsigned long ult_get_deadline_misses(tid_t tid)
+{
+  ult_t *t = lookup(tid);
+  if (NULL == t)
+  {
+    return 0;
+  }
+  return t->cold->deadline_misses;
+}
+
+unsigned long ult_get_total_deadline_misses()
+{
+  return total_deadline_misses;
+}
+
+int ult_set_priority(tid_t tid, int priority)
+{
+  block_signals();
+
+  ult_t *t = lookup(tid);
+  if (NULL == t || t->state == ULT_TERMINATED ||
+      priority < ULT_PRIO_MIN || priority > ULT_PRIO_MAX)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  t->base_priority = priority;
+  // keeps any boost inherited through held mutexes and passes the change down the chain
+  ult_mutex_update_priority(t);
+
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
+int ult_get_priority(tid_t tid)
+{
+  ult_t *t = lookup(tid);
+  if (NULL == t)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  return t->priority;
+}
+
+// change the priority the policy sees, signals must be blocked
+void ult_set_effective_priority(ult_t *t, int priority)
+{
+  bool queued = t->queued;
+  sched_dequeue(t);
+  t->priority = priority;
+  if (queued)
+  {
+    sched_enqueue(t);
+  }
+}
+
+// make timed-out threads ready again and return the earliest pending deadline (0 if none)
+static uint64_t wake_expired_threads()
+{
+  uint64_t now = now_ns();
+  uint64_t earliest = 0;
+
+  for (size_t i = 0; i < thread_count && timed_count > 0; i++)
+  {
+    ult_t *t = &threads_list[i];
+    if (0 == t->wake_at)
+    {
+      continue;
+    }
+
+    if (t->state != ULT_BLOCKED || now >= t->wake_at)
+    {
+      // either woken by someone else already, or the deadline passed
+      if (t->state == ULT_BLOCKED)
+      {
+        ult_make_ready(t);
+      }
+      t->wake_at = 0;
+      timed_count--;
+    }
+    else if (0 == earliest || t->wake_at < earliest)
+    {
+      earliest = t->wake_at;
+    }
+  }
+
+  return earliest;
+}
+
+// the thread passed to ult_yield_to, unless it blocked or its group ran out of quota since
+static ult_t *take_handoff()
+{
+  ult_t *t = handoff;
+  handoff = NULL;
+  if (ULT_READY != t->state || t == running ||
+      ult_group_is_throttled(get_group_by_id(t->group), now_ns()))
+  {
+    return NULL;
+  }
+  sched_dequeue(t);
+  lender = running;
+  borrower = t;
+  return t;
+}
+
 static ult_t *get_next_ready_thread()
 {
-  tid_t next_tid;
-  bool found = false;
-  size_t checked = 0;
-  while (checked < thread_count && !found)
+  ult_t *next = NULL;
+
+  while (NULL == next)
   {
-    next_tid = (running->tid + checked + 1) % thread_count;
-    if (ULT_READY == threads_list[next_tid].state)
+    if (ult_inbox_enabled())
+    {
+      ult_inbox_drain();
+    }
+
+    uint64_t earliest = 0;
+    if (timed_count > 0)
+    {
+      earliest = wake_expired_threads();
+    }
+
+    // the outgoing thread competes with the others if it is still runnable
+    if (ULT_READY == running->state)
+    {
+      sched_enqueue(running);
+    }
+
+    if (NULL != handoff)
+    {
+      next = take_handoff();
+    }
+    if (NULL == next)
+    {
+      next = policy->pick_next(running);
+    }
+    if (NULL != next)
+    {
+      next->queued = false;
+    }
+    else if (NULL != policy->next_wakeup)
+    {
+      // runnable threads the policy holds back (e.g. out of quota) count as a deadline
+      uint64_t held_until = policy->next_wakeup();
+      if (0 != held_until && (0 == earliest || held_until < earliest))
+      {
+        earliest = held_until;
+      }
+    }
+
+    if (NULL != next || (0 == earliest && !ult_inbox_may_wake()))
     {
-      found = true;
       break;
     }
-    checked++;
+
+    // everybody is blocked but someone has a deadline or a foreign thread may
+    // still wake one of them: idle until one of them happens
+    if (ult_inbox_enabled())
+    {
+      ult_inbox_idle(earliest);
+    }
+    else
+    {
+      uint64_t now = now_ns();
+      if (earliest > now)
+      {
+        struct timespec ts = {(earliest - now) / 1000000000ULL, (earliest - now) % 1000000000ULL};
+        nanosleep(&ts, NULL);
+      }
+    }
+    discard_pending_alarm();
+    ult_watchdog_resync();
   }
 
-  if (!found)
+  if (NULL == next)
   {
     bool all_blocked = true;
     for (size_t i = 0; i < thread_count; i++)
@@ -74,8 +443,15 @@ static ult_t *get_next_ready_thread()
       for (size_t i = 0; i < thread_count; i++)
       {
         ult_t *t = &threads_list[i];
-        printf("Thread %ld: %s\n", t->tid,
-               t->state == ULT_BLOCKED ? "BLOCKED" : "TERMINATED");
+        if (t->parked)
+        {
+          printf("Thread %ld: BLOCKED (parked on %p)\n", t->tid, t->cold->blocker);
+        }
+        else
+        {
+          printf("Thread %ld: %s\n", t->tid,
+                 t->state == ULT_BLOCKED ? "BLOCKED" : "TERMINATED");
+        }
       }
 
       display_deadlocks();
@@ -84,7 +460,7 @@ static ult_t *get_next_ready_thread()
     }
   }
 
-  return &threads_list[next_tid];
+  return next;
 }
 
 void ult_schedule(int signum)
@@ -96,20 +472,92 @@ void ult_schedule(int signum)
 
   // when we switch context, block incoming termination signals to the scheduler so it doesnt tell itself to stop
   block_signals();
+  in_scheduler = true;
   ult_t *current_t = running;
+
+  uint64_t now = now_ns();
+  uint64_t ran = now - current_t->switched_in;
+  current_t->cold->runtime_ns += ran;
+  ult_group_charge(current_t, ran, now);
+  if (ult_perf_enabled())
+  {
+    ult_perf_account(current_t);
+  }
+  if (ult_arena_enabled() && !ult_arena_stack_intact(current_t->cold->stack))
+  {
+    fprintf(stderr, "Thread %lu overflowed its stack\n", current_t->tid);
+    abort();
+  }
+  // switching out of a thread is an RCU quiescent state unless it is inside a read section
+  ult_rcu_quiescent(current_t);
+  check_deadline(current_t, now);
+  policy->on_tick(current_t, ran);
+  if (ULT_READY != current_t->state)
+  {
+    sched_dequeue(current_t);
+    if (ULT_BLOCKED == current_t->state)
+    {
+      ULT_PROBE_BLOCK(current_t->tid);
+      policy->on_block(current_t);
+    }
+  }
+
+  // a borrower giving the CPU up before the tick returns what is left of the slice
+  if (NULL != lender && current_t == borrower && NULL == handoff)
+  {
+    handoff = lender;
+  }
+  lender = NULL;
+
   running = get_next_ready_thread();
-  unblock_signals();
-  swapcontext(&current_t->context, &running->context);
+  running->switched_in = now_ns();
+  in_scheduler = false;
+  ULT_PROBE_SWITCH(current_t->tid, running->tid);
+  // keep SIGALRM blocked across the switch: the saved context resumes inside this
+  // handler and the mask is restored when it returns, so ticks never nest frames
+  if (NULL != running->cold->shared_stack)
+  {
+    // another thread's frames may occupy that stack, the switcher swaps them
+    ult_shstack_switch(current_t, running);
+  }
+  else
+  {
+    swapcontext(&current_t->cold->context, &running->cold->context);
+  }
+}
+
+static void on_alarm(int signum, siginfo_t *info, void *ucontext)
+{
+  // timer ticks come from the kernel, preemption requests from raise()
+  if (SI_KERNEL == info->si_code)
+  {
+    // the lent timeslice is over
+    lender = NULL;
+  }
+  if (SI_KERNEL == info->si_code && ult_watchdog_enabled())
+  {
+    // read before ult_schedule blocks signals and overwrites the site
+    ult_watchdog_tick(running->tid, critical_section_site(), critical_section_where());
+  }
+  if (SI_KERNEL == info->si_code && ult_profile_enabled())
+  {
+    ult_profile_tick(running, (ucontext_t *)ucontext);
+  }
+  if (ult_stack_usage_enabled())
+  {
+    ult_stack_note_signal(running, (ucontext_t *)ucontext, __builtin_frame_address(0));
+  }
+  ult_schedule(signum);
 }
 
 static int create_scheduler(long quota)
 {
   memset(&alarm, 0, sizeof(struct sigaction));
-  alarm.sa_handler = &ult_schedule; // scheduler decides who is the next to get CPU
+  alarm.sa_sigaction = &on_alarm; // scheduler decides who is the next to get CPU
 
   sigemptyset(&alarm.sa_mask); // set what signals we react to (in our case STOPSIG)
   sigaddset(&alarm.sa_mask, STOPSIG);
-  alarm.sa_flags |= SA_RESTART; // restart system calls if interrupted by handler
+  alarm.sa_flags |= SA_RESTART | SA_SIGINFO; // restart system calls if interrupted by handler
 
   struct sigaction old;
   if (sigaction(STOPSIG, &alarm, &old) == -1)
@@ -123,6 +571,7 @@ static int create_scheduler(long quota)
   schedule_clock.it_value.tv_sec = 0;
   schedule_clock.it_value.tv_usec = quota;
 
+  ult_watchdog_arm((uint64_t)quota * 1000);
   if (setitimer(ITIMER_REAL, &schedule_clock, NULL) == -1)
   {
     if (sigaction(STOPSIG, &old, NULL) == -1)
@@ -149,8 +598,22 @@ void deadlock_graphs(int signo)
   printf("\n#########Threads#########\n");
   for (size_t i = 0; i < thread_count; i++)
   {
-    printf("Thread %lu %s\n", threads_list[i].tid,
-           get_state_name(threads_list[i].state));
+    ult_t *t = &threads_list[i];
+    if (!ult_perf_enabled())
+    {
+      printf("Thread %lu %s\n", t->tid, get_state_name(t->state));
+      continue;
+    }
+
+    // integer math only, this runs on whatever ULT stack was interrupted
+    uint64_t cycles = t->cold->perf_counts[ULT_PERF_CYCLES];
+    uint64_t instructions = t->cold->perf_counts[ULT_PERF_INSTRUCTIONS];
+    uint64_t ipc = cycles ? instructions * 100 / cycles : 0;
+    uint64_t kinst = instructions / 1000;
+    printf("Thread %lu %s cycles %lu ipc %lu.%02lu llc-miss/kinst %lu branch-miss/kinst %lu\n",
+           t->tid, get_state_name(t->state), cycles, ipc / 100, ipc % 100,
+           kinst ? t->cold->perf_counts[ULT_PERF_LLC_MISSES] / kinst : 0,
+           kinst ? t->cold->perf_counts[ULT_PERF_BRANCH_MISSES] / kinst : 0);
   }
   printf("##################\n");
 
@@ -177,13 +640,53 @@ static int ult_display_handler()
   return EXIT_SUCCESS;
 }
 
+const ult_sched_ops_t *ult_get_policy()
+{
+  return policy;
+}
+
 int ult_init(long quota)
 {
+  ult_config_t config = {.quantum = quota, .policy = NULL};
+  return ult_init_config(&config);
+}
+
+int ult_init_config(const ult_config_t *config)
+{
+  if (0 != config->stack_size && config->stack_size < SIGSTKSZ)
+  {
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+  if (0 != config->stack_size)
+  {
+    // whole pages, so the stacks of a batch stay page aligned
+    stack_size = ult_stack_round(config->stack_size);
+  }
+  if (NULL != config->policy)
+  {
+    policy = config->policy;
+  }
+  handoff_enabled = config->handoff;
+  policy->init(config);
+
+  if (config->huge_arena)
+  {
+    if (EXIT_SUCCESS != ult_arena_init(sizeof(default_threads) + sizeof(default_cold), MAX_THREADS_COUNT, SIGSTKSZ, config->stack_guards))
+    {
+      perror("Failed to map the thread arena");
+      return EXIT_FAILURE;
+    }
+    threads_list = ult_arena_tcbs();
+    cold_list = (ult_cold_t *)(threads_list + MAX_THREADS_COUNT);
+  }
+
   running = init_next_ult(ULT_READY); // register main as an ult
-  main_context = &running->context;
+  main_context = &running->cold->context;
+  running->switched_in = now_ns();
 
   // create the scheduler, setup internal timer for each thread based on quota
-  int status = create_scheduler(quota);
+  int status = create_scheduler(config->quantum);
   if (EXIT_SUCCESS != status)
   {
     return status;
@@ -204,54 +707,333 @@ static void ult_wrapper()
   ult_t *t = running;
   unblock_signals();
 
-  void *result = t->start_routine(t->arg);
+  void *result = t->cold->start_routine(t->cold->arg);
   ult_exit(result);
 }
 
-ult_t *create_thread(state_t state, void *(*start_routine)(void *), void *arg)
+// the context gets the low `size` bytes of a SIGSTKSZ stack
+static int make_context(ucontext_t *context, void *stack, size_t size, ucontext_t *link, void (*entry)(void))
+{
+  if (NULL == stack)
+  {
+    stack = malloc(SIGSTKSZ);
+  }
+  if (NULL == stack)
+  {
+    return EXIT_FAILURE;
+  }
+
+  context->uc_stack.ss_sp = stack;
+  context->uc_stack.ss_size = size;
+  context->uc_stack.ss_flags = 0;
+  context->uc_link = link;
+  makecontext(context, entry, 0);
+
+  return EXIT_SUCCESS;
+}
+
+int ult_make_context(ucontext_t *context, void *stack, ucontext_t *link, void (*entry)(void))
+{
+  return make_context(context, stack, SIGSTKSZ, link, entry);
+}
+
+// size of the private stacks for start_routine, fixed in the huge page arena
+static size_t stack_size_for(void *(*start_routine)(void *))
+{
+  if (ult_arena_enabled())
+  {
+    return SIGSTKSZ;
+  }
+  size_t size = ult_stack_size_for(start_routine);
+  return 0 != size ? size : stack_size;
+}
+
+// the stack a slot kept is dropped when adaptive sizing wants another size
+static void drop_stack_unless(ult_t *t, size_t size)
+{
+  if (NULL != t->cold->stack && t->cold->stack_size != size)
+  {
+    if (t->cold->stack_owned)
+    {
+      free(t->cold->stack);
+    }
+    else if (NULL != t->cold->stack_batch && 0 == --t->cold->stack_batch->stacks)
+    {
+      munmap(t->cold->stack_batch->base, t->cold->stack_batch->length);
+      free(t->cold->stack_batch);
+    }
+    t->cold->stack = NULL;
+    t->cold->stack_batch = NULL;
+  }
+}
+
+// paint a new private stack below its `reserve` bytes and build its context
+static void setup_stack(ult_t *t, size_t size, size_t reserve)
+{
+  t->cold->stack_size = size;
+  if (ult_stack_usage_enabled())
+  {
+    ult_stack_paint(t->cold->stack, size - reserve);
+    t->cold->stack_painted = true;
+    t->cold->preempt_depth = 0;
+  }
+  make_context(&t->cold->context, t->cold->stack, size - reserve, main_context, (void (*)(void))ult_wrapper);
+}
+
+// `reserve` bytes at the top of a private stack are left out of the thread's frames
+ult_t *create_thread(state_t state, ult_shared_stack_t *shared_stack, size_t reserve, void *(*start_routine)(void *), void *arg)
 {
   ult_t *t = init_next_ult(state);
 
-  t->context.uc_stack.ss_sp = malloc(SIGSTKSZ);
-  t->context.uc_stack.ss_size = SIGSTKSZ;
-  t->context.uc_stack.ss_flags = 0;
-  t->context.uc_link = main_context;
-  makecontext(&t->context, (void (*)(void))ult_wrapper, 0); // set ult_wrapper function as entrypoint
+  // set ult_wrapper function as entrypoint
+  if (NULL != shared_stack)
+  {
+    ult_shstack_prepare(t, shared_stack, main_context, (void (*)(void))ult_wrapper);
+  }
+  else
+  {
+    size_t size = stack_size_for(start_routine);
+    drop_stack_unless(t, size);
+    if (NULL == t->cold->stack && ult_arena_enabled())
+    {
+      t->cold->stack = ult_arena_stack(ULT_TID_SLOT(t->tid));
+      t->cold->stack_owned = false;
+    }
+    else if (NULL == t->cold->stack)
+    {
+      t->cold->stack = malloc(size);
+      t->cold->stack_owned = true;
+    }
+    if (NULL == t->cold->stack)
+    {
+      perror("Failed to allocate thread stack");
+      exit(EXIT_FAILURE);
+    }
+    setup_stack(t, size, reserve);
+  }
 
-  t->start_routine = start_routine;
-  t->arg = arg;
+  t->cold->start_routine = start_routine;
+  t->cold->arg = arg;
 
   return t;
 }
 
 int ult_create(tid_t *tid, void *(*start_routine)(void *), void *arg)
 {
-  if (MAX_THREADS_COUNT - 1 == thread_count)
+  // new threads are accounted to the group of their creator
+  grpid_t group = NULL != running ? running->group : ULT_GROUP_ROOT;
+  return ult_create_in_group(tid, group, start_routine, arg);
+}
+
+int ult_create_in_group(tid_t *tid, grpid_t gid, void *(*start_routine)(void *), void *arg)
+{
+  if (MAX_THREADS_COUNT - 1 == thread_count && 0 == free_count)
   {
     return EXIT_FAILURE;
   }
 
   block_signals();
-  *tid = create_thread(ULT_READY, start_routine, arg)->tid;
+  ult_group_t *g = get_group_by_id(gid);
+  if (NULL == g)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  ult_t *t = create_thread(ULT_READY, g->shared_stack, 0, start_routine, arg);
+  t->group = gid;
+  sched_enqueue(t);
+  *tid = t->tid;
   unblock_signals();
 
   return 0;
 }
 
+// copied into every context of a batch, each copy gets its own FPU state pointer
+static ucontext_t batch_context;
+
+int ult_create_many(size_t count, void *(*start_routine)(void *), void **args, tid_t *tids)
+{
+  block_signals();
+  if (MAX_THREADS_COUNT - 1 - thread_count + free_count < count)
+  {
+    unblock_signals();
+    errno = EAGAIN;
+    return EXIT_FAILURE;
+  }
+  grpid_t gid = NULL != running ? running->group : ULT_GROUP_ROOT;
+  ult_group_t *g = get_group_by_id(gid);
+  if (NULL == g)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  // recycled slots keep their stacks if the size fits, the others share a
+  // single allocation. take_slot pops free_slots from the end
+  size_t size = stack_size_for(start_routine);
+  size_t bare = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    ult_cold_t *kept = i < free_count ? threads_list[free_slots[free_count - 1 - i]].cold : NULL;
+    if (NULL == kept || NULL == kept->stack || kept->stack_size != size)
+    {
+      bare++;
+    }
+  }
+  char *stacks = NULL;
+  ult_stack_batch_t *batch = NULL;
+  if (bare > 0 && NULL == g->shared_stack && !ult_arena_enabled())
+  {
+    // page aligned, so the top of each stack that makecontext writes is a single
+    // page. No huge pages: a fault would zero all of them, and compacting memory
+    // for them stalls the critical section
+    stacks = mmap(NULL, bare * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    batch = MAP_FAILED != stacks ? malloc(sizeof(ult_stack_batch_t)) : NULL;
+    if (NULL == batch)
+    {
+      if (MAP_FAILED != stacks)
+      {
+        munmap(stacks, bare * size);
+      }
+      unblock_signals();
+      errno = ENOMEM;
+      return EXIT_FAILURE;
+    }
+    batch->base = stacks;
+    batch->length = bare * size;
+    batch->stacks = 0;
+  }
+
+  if (getcontext(&batch_context) == -1)
+  {
+    perror("Failed to get context");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    ult_t *t = take_slot(ULT_READY);
+    t->cold->context = batch_context;
+    // the copy still points at the FPU state inside batch_context, which the
+    // first switch to the thread would load and the next batch overwrites
+    t->cold->context.uc_mcontext.fpregs = &t->cold->context.__fpregs_mem;
+    if (NULL != g->shared_stack)
+    {
+      ult_shstack_prepare(t, g->shared_stack, main_context, (void (*)(void))ult_wrapper);
+    }
+    else
+    {
+      drop_stack_unless(t, size);
+      if (NULL == t->cold->stack && NULL != stacks)
+      {
+        t->cold->stack = stacks;
+        t->cold->stack_owned = false;
+        t->cold->stack_batch = batch;
+        batch->stacks++;
+        stacks += size;
+      }
+      else if (NULL == t->cold->stack)
+      {
+        t->cold->stack = ult_arena_stack(ULT_TID_SLOT(t->tid));
+        t->cold->stack_owned = false;
+      }
+      setup_stack(t, size, 0);
+    }
+
+    t->cold->start_routine = start_routine;
+    t->cold->arg = NULL != args ? args[i] : NULL;
+    t->group = gid;
+    sched_enqueue(t);
+    tids[i] = t->tid;
+  }
+  unblock_signals();
+
+  return EXIT_SUCCESS;
+}
+
+int ult_prepare(tid_t *tid, size_t reserve, void **space)
+{
+  reserve = (reserve + 15) & ~(size_t)15;
+  if (reserve > ULT_STACK_RESERVE_MAX)
+  {
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  block_signals();
+  if (MAX_THREADS_COUNT - 1 == thread_count && 0 == free_count)
+  {
+    unblock_signals();
+    errno = EAGAIN;
+    return EXIT_FAILURE;
+  }
+  grpid_t gid = NULL != running ? running->group : ULT_GROUP_ROOT;
+  ult_group_t *g = get_group_by_id(gid);
+  if (NULL == g || NULL != g->shared_stack)
+  {
+    // the top of a shared stack holds the frames of whichever thread ran last
+    unblock_signals();
+    errno = NULL == g ? EINVAL : ENOTSUP;
+    return EXIT_FAILURE;
+  }
+
+  // parked until ult_start, with no routine so ult_start can tell it apart
+  ult_t *t = create_thread(ULT_BLOCKED, NULL, reserve, NULL, NULL);
+  t->group = gid;
+  *space = (char *)t->cold->context.uc_stack.ss_sp + t->cold->context.uc_stack.ss_size;
+  *tid = t->tid;
+  unblock_signals();
+
+  return EXIT_SUCCESS;
+}
+
+int ult_start(tid_t tid, void *(*start_routine)(void *), void *arg)
+{
+  block_signals();
+
+  ult_t *t = lookup(tid);
+  if (NULL == t || t->state != ULT_BLOCKED || NULL != t->cold->start_routine || NULL == start_routine)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  t->cold->start_routine = start_routine;
+  t->cold->arg = arg;
+  ult_make_ready(t);
+
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
 int ult_join(tid_t tid, void **retval)
 {
   block_signals();
 
-  ult_t *target = &threads_list[tid];
+  ult_t *target = lookup(tid);
   ult_t *current = running;
 
+  // another joiner owns the target, even once it terminated: it reaps the slot
+  if (NULL == target || target->detached ||
+      (target->has_joiner && target->joiner != current->tid))
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
   // check if target thread is terminated
   if (target->state == ULT_TERMINATED)
   {
     if (retval != NULL)
     {
-      *retval = target->retval;
+      *retval = target->cold->retval;
     }
+    release_thread(target);
     unblock_signals();
     return EXIT_SUCCESS;
   }
@@ -282,36 +1064,310 @@ int ult_join(tid_t tid, void **retval)
 
   if (retval != NULL)
   {
-    *retval = target->retval;
+    *retval = target->cold->retval;
+  }
+  release_thread(target);
+  unblock_signals();
+
+  return EXIT_SUCCESS;
+}
+
+int ult_join_any(const tid_t *tids, size_t count, size_t *index, void **retval)
+{
+  block_signals();
+  ult_t *current = running;
+
+  if (0 == count)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    ult_t *target = lookup(tids[i]);
+    if (NULL == target || target->detached ||
+        (target->has_joiner && target->joiner != current->tid))
+    {
+      unblock_signals();
+      errno = EINVAL;
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (;;)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      ult_t *target = &threads_list[ULT_TID_SLOT(tids[i])];
+      if (target->state != ULT_TERMINATED)
+      {
+        continue;
+      }
+
+      // found one, drop our claim on the others
+      for (size_t j = 0; j < count; j++)
+      {
+        threads_list[ULT_TID_SLOT(tids[j])].has_joiner = false;
+        threads_list[ULT_TID_SLOT(tids[j])].joiner = -1;
+      }
+      current->state = ULT_READY;
+      current->waiting_for = -1;
+
+      if (index != NULL)
+      {
+        *index = i;
+      }
+      if (retval != NULL)
+      {
+        *retval = target->cold->retval;
+      }
+      release_thread(target);
+      unblock_signals();
+      return EXIT_SUCCESS;
+    }
+
+    // become the joiner of every child, whichever exits first wakes us
+    for (size_t i = 0; i < count; i++)
+    {
+      threads_list[ULT_TID_SLOT(tids[i])].has_joiner = true;
+      threads_list[ULT_TID_SLOT(tids[i])].joiner = current->tid;
+    }
+    current->state = ULT_BLOCKED;
+    current->waiting_for = ULT_JOIN_ANY;
+
+    unblock_signals();
+    ult_yield();
+    block_signals();
+  }
+}
+
+// The three calls below let ult_wait_any wait for a thread's exit among other
+// objects, SIGALRM must be blocked. A claim makes the caller the joiner of tid
+// without blocking; the exit unparks it
+int ult_join_claim(tid_t tid)
+{
+  ult_t *target = lookup(tid);
+  if (NULL == target || target->detached || target == running ||
+      (target->has_joiner && target->joiner != running->tid))
+  {
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  target->has_joiner = true;
+  target->joiner = running->tid;
+  running->waiting_for = ULT_WAIT_ANY;
+  return EXIT_SUCCESS;
+}
+
+void ult_join_unclaim(tid_t tid)
+{
+  ult_t *target = &threads_list[ULT_TID_SLOT(tid)];
+  if (target->has_joiner && target->joiner == running->tid)
+  {
+    target->has_joiner = false;
+    target->joiner = -1;
+  }
+  running->waiting_for = -1;
+}
+
+// join the claimed thread tid, which has terminated, and free its slot
+void *ult_join_reap(tid_t tid)
+{
+  ult_t *target = &threads_list[ULT_TID_SLOT(tid)];
+  ult_join_unclaim(tid);
+  void *retval = target->cold->retval;
+  release_thread(target);
+  return retval;
+}
+
+int ult_detach(tid_t tid)
+{
+  block_signals();
+
+  ult_t *target = lookup(tid);
+  if (NULL == target || target->detached || target->has_joiner)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  target->detached = true;
+  if (target->state == ULT_TERMINATED && target != running)
+  {
+    release_thread(target);
+  }
+
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
+// SIGALRM must not be blocked by the caller
+void ult_yield()
+{
+  // run the scheduler right here instead of raising SIGALRM: a signal frame (several KB
+  // with the AVX state) would stay on the stack of every parked thread
+  block_signals();
+  ult_schedule(STOPSIG);
+  unblock_signals();
+}
+
+// give the rest of the timeslice to tid, which must be ready; SIGALRM must not be blocked
+int ult_yield_to(tid_t tid)
+{
+  block_signals();
+
+  ult_t *target = lookup(tid);
+  if (NULL == target || target == running || ULT_READY != target->state)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+
+  handoff = target;
+  ult_schedule(STOPSIG);
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
+bool ult_handoff_enabled()
+{
+  return handoff_enabled;
+}
+
+void ult_sleep(long usec)
+{
+  block_signals();
+  running->state = ULT_BLOCKED;
+  ult_set_timeout(running, now_ns() + (uint64_t)usec * 1000);
+  unblock_signals();
+  ult_yield();
+}
+
+int ult_park(const void *blocker)
+{
+  return ult_park_until(blocker, 0);
+}
+
+int ult_park_until(const void *blocker, uint64_t deadline_ns)
+{
+  block_signals();
+  if (running->permit)
+  {
+    running->permit = false;
+    unblock_signals();
+    return EXIT_SUCCESS;
+  }
+
+  running->state = ULT_BLOCKED;
+  running->parked = true;
+  running->cold->blocker = blocker;
+  if (0 != deadline_ns)
+  {
+    ult_set_timeout(running, deadline_ns);
   }
   unblock_signals();
+  ult_yield();
+
+  block_signals();
+  bool unparked = running->permit;
+  running->permit = false;
+  running->parked = false;
+  running->cold->blocker = NULL;
+  unblock_signals();
 
+  if (!unparked && 0 != deadline_ns && now_ns() >= deadline_ns)
+  {
+    errno = ETIMEDOUT;
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
 
-void ult_yield() { raise(STOPSIG); }
+// give t its permit and wake it if parked, signals must be blocked
+void ult_unpark_thread(ult_t *t)
+{
+  if (ULT_TERMINATED == t->state)
+  {
+    return;
+  }
+  t->permit = true;
+  if (t->parked && ULT_BLOCKED == t->state)
+  {
+    ult_make_ready(t);
+  }
+}
+
+int ult_unpark(tid_t tid)
+{
+  block_signals();
+  ult_t *t = lookup(tid);
+  if (NULL == t || ULT_TERMINATED == t->state)
+  {
+    unblock_signals();
+    errno = EINVAL;
+    return EXIT_FAILURE;
+  }
+  ult_unpark_thread(t);
+  unblock_signals();
+  return EXIT_SUCCESS;
+}
+
+const void *ult_get_blocker(tid_t tid)
+{
+  ult_t *t = lookup(tid);
+  if (NULL == t || !t->parked)
+  {
+    return NULL;
+  }
+  return t->cold->blocker;
+}
 
 void ult_exit(void *retval)
 {
   block_signals();
 
-  running->retval = retval;
+  ULT_PROBE_EXIT(running->tid, retval);
+  if (running->cold->stack_painted)
+  {
+    ult_stack_measure(running->cold->start_routine, running->cold->stack, running->cold->stack_size,
+                      running->cold->preempt_depth);
+  }
+  running->cold->retval = retval;
   running->state = ULT_TERMINATED;
+  ult_arena_release(running->tid);
+  check_deadline(running, now_ns());
 
   if (running->has_joiner)
   {
-    tid_t joiner = running->joiner;
-    if (joiner >= 0 && joiner < thread_count)
+    ult_t *joiner_thread = lookup(running->joiner);
+    if (NULL != joiner_thread)
     {
-      ult_t *joiner_thread = &threads_list[joiner];
-      if (joiner_thread->state == ULT_BLOCKED &&
-          joiner_thread->waiting_for == running->tid)
+      if (joiner_thread->waiting_for == ULT_WAIT_ANY)
       {
-        joiner_thread->state = ULT_READY;
+        // a permit if it has not parked yet, e.g. preempted while releasing its mutex
+        ult_unpark_thread(joiner_thread);
+      }
+      else if (joiner_thread->state == ULT_BLOCKED &&
+               (joiner_thread->waiting_for == running->tid ||
+                joiner_thread->waiting_for == ULT_JOIN_ANY))
+      {
+        ult_make_ready(joiner_thread);
       }
     }
   }
 
+  // nobody will join a detached thread, its slot can be reused right away:
+  // the stack is only overwritten once another thread runs ult_create
+  if (running->detached)
+  {
+    release_thread(running);
+  }
+
   unblock_signals();
   ult_yield();
 }
@@ -320,20 +1376,22 @@ tid_t ult_self() { return running->tid; }
 
 bool ult_is_thread_waiting_for(tid_t waiter, tid_t target)
 {
-  if (waiter >= thread_count || target >= thread_count)
+  ult_t *t = lookup(waiter);
+  if (NULL == t || NULL == lookup(target))
   {
     return false;
   }
-  return threads_list[waiter].waiting_for == target;
+  return t->waiting_for == target;
 }
 
 bool ult_is_thread_terminated(tid_t tid)
 {
-  if (tid >= thread_count)
+  ult_t *t = lookup(tid);
+  if (NULL == t)
   {
     return false;
   }
-  return threads_list[tid].state == ULT_TERMINATED;
+  return t->state == ULT_TERMINATED;
 }
 
 ult_t *get_current_thread()
@@ -347,9 +1405,15 @@ ult_t *get_current_thread()
 
 ult_t *get_thread_by_id(tid_t tid)
 {
-  if (tid >= thread_count)
+  return lookup(tid);
+}
+
+// the thread in a slot of the thread table, for the per-thread tables indexed by slot
+ult_t *get_thread_by_slot(size_t slot)
+{
+  if (slot >= thread_count)
     return NULL;
-  return &threads_list[tid];
+  return &threads_list[slot];
 }
 
 size_t ult_get_thread_count()
@@ -2,39 +2,155 @@
 #define ULT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <ucontext.h>
 
+#ifndef MAX_THREADS_COUNT
 #define MAX_THREADS_COUNT 1000
+#endif
+
+// mutexes, condition variables, wait groups, futures and coroutines each
+#ifndef MAX_SYNC_COUNT
+#define MAX_SYNC_COUNT 1000
+#endif
+
+#define ULT_STACK_RESERVE_MAX 1024  // bytes ult_prepare can keep at the top of a new thread's stack
+
+#define ULT_PERF_COUNTERS 4  // hardware counters kept per thread, see perf.h
+
+#define ULT_PRIO_MIN 0
+#define ULT_PRIO_MAX 99
+#define ULT_PRIO_DEFAULT ULT_PRIO_MIN
 
 typedef enum state_t { ULT_BLOCKED, ULT_READY, ULT_TERMINATED } state_t;
 
 typedef unsigned long int tid_t;
 
-typedef struct ult {
-    tid_t tid;
-    state_t state;
+// A tid is the thread's slot in the thread table, with a count of the earlier
+// threads that used the slot in the high bits, so the tid of a reaped thread
+// never names the thread that took its slot. Per-thread tables use the slot.
+#define ULT_TID_GENERATION (1UL << 32)
+#define ULT_TID_SLOT(tid) ((size_t)((tid) & (ULT_TID_GENERATION - 1)))
+typedef size_t grpid_t;
+
+// Rarely touched per-thread state: the machine context, the stack and statistics.
+// Kept in its own table so scans over ult_t stay within a couple of cache lines per thread.
+typedef struct ult_cold {
     ucontext_t context;
     void *(*start_routine)(void *);
     void *arg;
     void *retval;
+    void *stack;           // kept across slot reuse
+    size_t stack_size;
+    bool stack_owned;      // malloc'ed for this slot alone, so it can be freed
+    struct ult_stack_batch *stack_batch;  // mapping shared by a ult_create_many batch, or NULL
+    bool stack_painted;    // measured at exit, see stackuse.h
+    size_t preempt_depth;  // deepest point a tick interrupted on the painted stack
+
+    uint64_t runtime_ns;   // total CPU time
+    unsigned long deadline_misses;
+    uint64_t perf_counts[ULT_PERF_COUNTERS]; // hardware counters while on the CPU, perf.h
+    const void *blocker;   // object given to ult_park, for diagnostics
+
+    // shared stack mode, see shstack.h
+    struct ult_shared_stack *shared_stack;  // NULL when the thread owns its stack
+    bool stack_fresh;                       // first frame not built yet
+    void *stack_copy;                       // frames saved while another thread uses the stack
+    size_t stack_copy_size;
+    size_t stack_copy_capacity;
+} ult_cold_t;
+
+// Scheduler-facing state. The first cache line holds what the scheduler and the
+// timeout scan read for every thread, the second one what blocking and joining use.
+typedef struct ult_thread {
+    tid_t tid;
+    uint64_t wake_at;      // monotonic ns deadline for a timed block, 0 if none
+    uint64_t sched_key;    // ordering key inside the policy's queue
+    uint64_t vruntime;     // virtual runtime, fair policy
+    uint64_t switched_in;  // when the thread last got the CPU
+    uint64_t deadline;     // absolute monotonic ns, 0 for best effort
+    size_t sched_index;    // position inside the policy's queue
+    state_t state;
+    int priority;          // effective priority, raised by priority inheritance
 
     tid_t waiting_for;
-    bool has_joiner;
     tid_t joiner;
-} ult_t;
+    tid_t blocked_on;      // mutex the thread is waiting for, -1 if none
+    tid_t held_mutexes;    // first mutex of the list of mutexes held, -1 if none
+    grpid_t group;         // CPU accounting group, inherited from the creator
+    ult_cold_t *cold;      // same index in the cold table
+    int base_priority;     // set with ult_set_priority, higher runs first
+    bool queued;           // currently in the policy's run queue
+    bool has_joiner;
+    bool detached;         // slot is released on exit instead of on join
+    bool released;         // slot is on the free list, reaped or detached and exited
+    bool deadline_counted; // this deadline's miss was already recorded
+    bool parked;           // blocked in ult_park, woken by ult_unpark
+    bool permit;           // an ult_unpark not consumed by ult_park yet
+} __attribute__((aligned(64))) ult_t;
+
+struct ult_sched_ops;
+
+typedef struct ult_config {
+    long quantum;                         // timeslice in microseconds
+    const struct ult_sched_ops *policy;   // NULL selects round robin
+    bool huge_arena;                      // thread blocks and stacks on huge pages, see hugepage.h
+    bool stack_guards;                    // check a canary under each arena stack on every switch
+    bool handoff;                         // cond signal and mutex unlock yield to the thread they wake
+    size_t stack_size;                    // private stacks, 0 for SIGSTKSZ; adaptive sizes replace it
+} ult_config_t;
 
 int ult_init(long quantum);
+int ult_init_config(const ult_config_t *config);
 int ult_create(tid_t *thread_id, void *(*start_routine)(void *), void *arg);
+int ult_create_in_group(tid_t *thread_id, grpid_t group_id, void *(*start_routine)(void *), void *arg);
+// count threads running start_routine(args[i]) (NULL args passes NULL to each), made
+// under one critical section with their stacks carved from one allocation; all or none
+int ult_create_many(size_t count, void *(*start_routine)(void *), void **args, tid_t *thread_ids);
+// two step create: a parked thread with `reserve` bytes at the top of its stack
+// for the caller to fill (e.g. a closure), then started with its routine
+int ult_prepare(tid_t *thread_id, size_t reserve, void **space);
+int ult_start(tid_t thread_id, void *(*start_routine)(void *), void *arg);
 int ult_join(tid_t thread_id, void **retval);
+int ult_join_any(const tid_t *thread_ids, size_t count, size_t *index, void **retval);
+int ult_detach(tid_t thread_id);
 tid_t ult_self();
 void ult_exit(void *retval);
 void ult_yield(void);
+// run a ready thread next on the rest of the timeslice, returned if it blocks before the tick
+int ult_yield_to(tid_t thread_id);
+bool ult_handoff_enabled();
+void ult_sleep(long usec);
+// block until ult_unpark(self) or deadline_ns (monotonic, 0 for none). An unpark
+// sent before the park is kept as a permit, so it is never lost, but the return
+// may be spurious: recheck the condition waited for. `blocker` names it in diagnostics
+int ult_park(const void *blocker);
+int ult_park_until(const void *blocker, uint64_t deadline_ns);
+int ult_unpark(tid_t thread_id);
+const void *ult_get_blocker(tid_t thread_id);
+
+int ult_set_deadline(tid_t thread_id, long usec);
+unsigned long ult_get_deadline_misses(tid_t thread_id);
+unsigned long ult_get_total_deadline_misses();
+
+int ult_set_priority(tid_t thread_id, int priority);
+int ult_get_priority(tid_t thread_id);
 
 bool ult_is_thread_waiting_for(tid_t waiter, tid_t target);
 bool ult_is_thread_terminated(tid_t tid);
 ult_t* get_current_thread();
+const struct ult_sched_ops *ult_get_policy();
 ult_t* get_thread_by_id(tid_t tid);
+ult_t* get_thread_by_slot(size_t slot);
 size_t ult_get_thread_count();
+void ult_set_timeout(ult_t *t, uint64_t deadline_ns);
+void ult_make_ready(ult_t *t);
+void ult_unpark_thread(ult_t *t);
+int ult_join_claim(tid_t thread_id);
+void ult_join_unclaim(tid_t thread_id);
+void *ult_join_reap(tid_t thread_id);
+void ult_set_effective_priority(ult_t *t, int priority);
+int ult_make_context(ucontext_t *context, void *stack, ucontext_t *link, void (*entry)(void));
 
 #endif
@@ -0,0 +1,215 @@
+#ifndef ULT_HPP
+#define ULT_HPP
+
+// C++17 interface, header only. ult::thread builds its callable and arguments
+// in the space ult_prepare keeps at the top of the new ULT's stack, so spawning
+// allocates nothing, and joins on destruction like std::jthread. ult::mutex
+// meets the standard Lockable requirements, so std::lock_guard and
+// std::unique_lock work with it; condition_variable waits with a predicate go
+// through ult_cond_wait_pred and are only woken once the predicate holds.
+
+#include <cerrno>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "ult.h"
+#include "mutex.h"
+#include "cond.h"
+}
+
+namespace ult {
+
+[[noreturn]] inline void throw_errno(const char *what) {
+    throw std::system_error(errno != 0 ? errno : EAGAIN, std::generic_category(), what);
+}
+
+class thread {
+public:
+    thread() noexcept = default;
+
+    template <class F, class... Args,
+              class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, thread>>>
+    explicit thread(F &&f, Args &&...args) {
+        using state_type = state<std::decay_t<F>, std::decay_t<Args>...>;
+        static_assert(sizeof(state_type) <= ULT_STACK_RESERVE_MAX,
+                      "the callable and its arguments must fit in ULT_STACK_RESERVE_MAX bytes");
+        static_assert(alignof(state_type) <= 16, "over-aligned callables are not supported");
+
+        tid_t tid;
+        void *space;
+        if (EXIT_SUCCESS != ult_prepare(&tid, sizeof(state_type), &space)) {
+            throw_errno("ult_prepare");
+        }
+        try {
+            ::new (space) state_type(std::forward<F>(f), std::forward<Args>(args)...);
+        } catch (...) {
+            // the ULT exists already: let it exit without running anything
+            ult_start(tid, &nothing, nullptr);
+            ult_join(tid, nullptr);
+            throw;
+        }
+        ult_start(tid, &run<state_type>, space);
+        id_ = tid;
+        joinable_ = true;
+    }
+
+    thread(thread &&other) noexcept : id_(other.id_), joinable_(std::exchange(other.joinable_, false)) {}
+
+    thread &operator=(thread &&other) {
+        if (this != &other) {
+            if (joinable()) {
+                join();
+            }
+            id_ = other.id_;
+            joinable_ = std::exchange(other.joinable_, false);
+        }
+        return *this;
+    }
+
+    thread(const thread &) = delete;
+    thread &operator=(const thread &) = delete;
+
+    ~thread() {
+        if (joinable()) {
+            join();
+        }
+    }
+
+    bool joinable() const noexcept { return joinable_; }
+    tid_t get_id() const noexcept { return id_; }
+
+    void join() {
+        if (!joinable_ || EXIT_SUCCESS != ult_join(id_, nullptr)) {
+            throw_errno("ult_join");
+        }
+        joinable_ = false;
+    }
+
+    void detach() {
+        if (!joinable_ || EXIT_SUCCESS != ult_detach(id_)) {
+            throw_errno("ult_detach");
+        }
+        joinable_ = false;
+    }
+
+private:
+    template <class F, class... Args>
+    struct state {
+        F fn;
+        std::tuple<Args...> args;
+
+        template <class G, class... A>
+        explicit state(G &&g, A &&...a) : fn(std::forward<G>(g)), args(std::forward<A>(a)...) {}
+    };
+
+    // the state lives on this ULT's stack and dies with the call; a ULT that
+    // calls ult_exit() skips its destructor
+    template <class State>
+    static void *run(void *space) {
+        State *s = static_cast<State *>(space);
+        try {
+            std::apply(std::move(s->fn), std::move(s->args));
+        } catch (...) {
+            // there is no C++ frame above this one to unwind into
+            std::terminate();
+        }
+        s->~State();
+        return nullptr;
+    }
+
+    static void *nothing(void *) { return nullptr; }
+
+    tid_t id_ = 0;
+    bool joinable_ = false;
+};
+
+class mutex {
+public:
+    mutex() {
+        if (EXIT_SUCCESS != ult_mutex_init(&id_)) {
+            throw_errno("ult_mutex_init");
+        }
+    }
+
+    explicit mutex(ult_mutex_protocol_t protocol) {
+        if (EXIT_SUCCESS != ult_mutex_init_protocol(&id_, protocol)) {
+            throw_errno("ult_mutex_init_protocol");
+        }
+    }
+
+    mutex(const mutex &) = delete;
+    mutex &operator=(const mutex &) = delete;
+
+    ~mutex() { ult_mutex_destroy(id_); }
+
+    void lock() {
+        if (EXIT_SUCCESS != ult_mutex_lock(id_)) {
+            throw_errno("ult_mutex_lock");
+        }
+    }
+
+    bool try_lock() noexcept { return EXIT_SUCCESS == ult_mutex_trylock(id_); }
+    void unlock() noexcept { ult_mutex_unlock(id_); }
+    tid_t native_handle() const noexcept { return id_; }
+
+private:
+    tid_t id_;
+};
+
+template <class Mutex>
+using lock_guard = std::lock_guard<Mutex>;
+
+template <class Mutex>
+using unique_lock = std::unique_lock<Mutex>;
+
+class condition_variable {
+public:
+    condition_variable() {
+        if (EXIT_SUCCESS != ult_cond_init(&id_)) {
+            throw_errno("ult_cond_init");
+        }
+    }
+
+    condition_variable(const condition_variable &) = delete;
+    condition_variable &operator=(const condition_variable &) = delete;
+
+    ~condition_variable() { ult_cond_destroy(id_); }
+
+    void notify_one() noexcept { ult_cond_signal(id_); }
+    void notify_all() noexcept { ult_cond_broadcast(id_); }
+
+    void wait(unique_lock<mutex> &lock) {
+        if (EXIT_SUCCESS != ult_cond_wait(id_, lock.mutex()->native_handle())) {
+            throw_errno("ult_cond_wait");
+        }
+    }
+
+    // pred is also evaluated by the notifying thread, with SIGALRM blocked: it
+    // must only read state guarded by the mutex, and must not throw
+    template <class Predicate>
+    void wait(unique_lock<mutex> &lock, Predicate pred) {
+        if (EXIT_SUCCESS != ult_cond_wait_pred(id_, lock.mutex()->native_handle(), &check<Predicate>, &pred)) {
+            throw_errno("ult_cond_wait_pred");
+        }
+    }
+
+    cid_t native_handle() const noexcept { return id_; }
+
+private:
+    template <class Predicate>
+    static bool check(void *pred) {
+        return static_cast<bool>((*static_cast<Predicate *>(pred))());
+    }
+
+    cid_t id_;
+};
+
+}  // namespace ult
+
+#endif
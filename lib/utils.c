@@ -6,8 +6,11 @@
 #include <stdlib.h>
 #include <time.h>
 
-void block_signals() {
-  sigset_t mask; 
+static const char *last_site = "";
+static const char *last_where = "";
+
+void block_signals_at(const char *site, const char *where) {
+  sigset_t mask;
   sigemptyset(&mask);
   sigaddset(&mask, SIGALRM);
 
@@ -15,8 +18,15 @@ void block_signals() {
     perror("sigprocmask cannot block ALRM signal");
     abort();
   }
+
+  last_site = site;
+  last_where = where;
 }
 
+// the function that blocked SIGALRM most recently, and its file:line
+const char *critical_section_site() { return last_site; }
+const char *critical_section_where() { return last_where; }
+
 void unblock_signals() {
   sigset_t mask;
   sigemptyset(&mask);
@@ -28,6 +38,18 @@ void unblock_signals() {
   }
 }
 
+// drop a tick that fired while the scheduler was idling with SIGALRM blocked,
+// otherwise it is delivered on top of the resumed thread's scheduler frame
+void discard_pending_alarm() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGALRM);
+
+  struct timespec zero = {0, 0};
+  while (sigtimedwait(&mask, NULL, &zero) == SIGALRM) {
+  }
+}
+
 int ms_sleep(unsigned int ms) {
   int result = 0;
 
@@ -45,4 +67,10 @@ int ms_sleep(unsigned int ms) {
   }
 
   return result;
-}
\ No newline at end of file
+}
+
+uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -1,8 +1,20 @@
 #ifndef ULT_UTIL_H
 #define ULT_UTIL_H
 
-void block_signals();
+#include <stdint.h>
+
+#define ULT_STR(x) #x
+#define ULT_XSTR(x) ULT_STR(x)
+
+// records which function disabled preemption last, for the watchdog (watchdog.h)
+#define block_signals() block_signals_at(__func__, __FILE__ ":" ULT_XSTR(__LINE__))
+
+void block_signals_at(const char *site, const char *where);
+const char *critical_section_site();
+const char *critical_section_where();
 void unblock_signals();
+void discard_pending_alarm();
 int ms_sleep(unsigned int ms);
+uint64_t now_ns();
 
 #endif
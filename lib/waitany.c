@@ -0,0 +1,153 @@
+#include "waitany.h"
+#include "cond.h"
+#include "mutex.h"
+#include "utils.h"
+
+#include <errno.h>
+
+static int add_waiter(ult_wait_obj_t *obj) {
+    switch (obj->kind) {
+    case ULT_WAIT_COND:
+        return ult_cond_add_waiter(obj->id, obj->mutex);
+    case ULT_WAIT_THREAD:
+        return ult_join_claim(obj->id);
+    case ULT_WAIT_MUTEX:
+        return ult_mutex_add_waiter(obj->id);
+    }
+    errno = EINVAL;
+    return EXIT_FAILURE;
+}
+
+// leave the waiting lists of the first count objects, except the one that fired
+static void remove_waiter(ult_wait_obj_t *objs, size_t count, size_t fired) {
+    for (size_t i = 0; i < count; i++) {
+        if (i == fired) {
+            continue;
+        }
+        switch (objs[i].kind) {
+        case ULT_WAIT_COND:
+            ult_cond_remove_waiter(objs[i].id);
+            break;
+        case ULT_WAIT_THREAD:
+            ult_join_unclaim(objs[i].id);
+            break;
+        case ULT_WAIT_MUTEX:
+            ult_mutex_remove_waiter(objs[i].id);
+            break;
+        }
+    }
+}
+
+// index of the first object that fired, count if none. A free mutex is taken
+static size_t first_fired(ult_wait_obj_t *objs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        switch (objs[i].kind) {
+        case ULT_WAIT_COND:
+            if (ult_cond_signaled(objs[i].id)) {
+                return i;
+            }
+            break;
+        case ULT_WAIT_THREAD:
+            if (ult_is_thread_terminated(objs[i].id)) {
+                return i;
+            }
+            break;
+        case ULT_WAIT_MUTEX:
+            if (ult_mutex_take(objs[i].id)) {
+                return i;
+            }
+            break;
+        }
+    }
+    return count;
+}
+
+int ult_wait_any(ult_wait_obj_t *objs, size_t count, long timeout_us, size_t *index) {
+    if (0 == count) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    // one mutex for every condition variable, and not waited for itself
+    tid_t cond_mutex = -1;
+    for (size_t i = 0; i < count; i++) {
+        if (ULT_WAIT_COND == objs[i].kind) {
+            if ((tid_t)-1 != cond_mutex && objs[i].mutex != cond_mutex) {
+                errno = EINVAL;
+                return EXIT_FAILURE;
+            }
+            cond_mutex = objs[i].mutex;
+        }
+    }
+    for (size_t i = 0; i < count && (tid_t)-1 != cond_mutex; i++) {
+        if (ULT_WAIT_MUTEX == objs[i].kind && objs[i].id == cond_mutex) {
+            errno = EINVAL;
+            return EXIT_FAILURE;
+        }
+    }
+
+    block_signals();
+    uint64_t deadline = 0;
+    if (timeout_us >= 0) {
+        deadline = now_ns() + (uint64_t)timeout_us * 1000;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (EXIT_SUCCESS != add_waiter(&objs[i])) {
+            remove_waiter(objs, i, i);
+            unblock_signals();
+            return EXIT_FAILURE;
+        }
+    }
+
+    // a thread that already exited or a free mutex returns without releasing
+    // the condition's mutex
+    size_t fired = first_fired(objs, count);
+    bool released = false;
+    if (count == fired && (tid_t)-1 != cond_mutex) {
+        tid_t woken;
+        if (EXIT_SUCCESS != ult_mutex_release(cond_mutex, &woken)) {
+            remove_waiter(objs, count, count);
+            unblock_signals();
+            return EXIT_FAILURE;
+        }
+        released = true;
+
+        // with handoff the thread the release woke runs first
+        if (-1 != woken && ult_handoff_enabled()) {
+            unblock_signals();
+            ult_yield_to(woken);
+            block_signals();
+            fired = first_fired(objs, count);
+        }
+    }
+
+    // every object unparks us when it fires, an unpark in between is kept as the permit
+    while (count == fired) {
+        if (0 != deadline && now_ns() >= deadline) {
+            break;
+        }
+        unblock_signals();
+        ult_park_until(objs, deadline);
+        block_signals();
+        fired = first_fired(objs, count);
+    }
+
+    remove_waiter(objs, count, fired);
+    if (fired < count && ULT_WAIT_THREAD == objs[fired].kind) {
+        objs[fired].retval = ult_join_reap(objs[fired].id);
+    }
+    unblock_signals();
+
+    if (released) {
+        ult_mutex_lock(cond_mutex);
+    }
+    if (count == fired) {
+        errno = ETIMEDOUT;
+        return EXIT_FAILURE;
+    }
+    if (index != NULL) {
+        *index = fired;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#ifndef ULT_WAITANY_H
+#define ULT_WAITANY_H
+
+#include "ult.h"
+#include <stddef.h>
+
+// Wait for whichever comes first out of several objects, like select: a signal
+// of a condition variable, the exit of a thread, a mutex becoming free. The
+// caller is put on every object's waiting list in one critical section and
+// parks once. When one of them fires it takes itself off the others: a signal
+// it got but does not return is passed on to the next waiter of that condition
+// variable, a free mutex it does not take wakes the next thread waiting for it.
+//
+// Exactly one object is returned, the first in the array that fired:
+//   ULT_WAIT_COND    signaled. All condition objects must name the same mutex,
+//                    held by the caller, which is released while waiting and
+//                    held again on return, whatever fired
+//   ULT_WAIT_THREAD  the thread exited and was joined, its result is in retval
+//   ULT_WAIT_MUTEX   the caller holds the mutex
+// A thread waiting for a mutex here lends its priority to the holder, but it
+// does not take part in priority inheritance chains and display_deadlocks()
+// sees it as waiting for each of its mutexes.
+
+typedef enum ult_wait_kind {
+    ULT_WAIT_COND,
+    ULT_WAIT_THREAD,
+    ULT_WAIT_MUTEX
+} ult_wait_kind_t;
+
+typedef struct {
+    ult_wait_kind_t kind;
+    size_t id;          // condition variable, thread or mutex id
+    tid_t mutex;        // ULT_WAIT_COND: the mutex of the condition
+    void *retval;       // ULT_WAIT_THREAD: set when the thread was joined
+} ult_wait_obj_t;
+
+// timeout_us < 0 waits forever; ETIMEDOUT if nothing fired in time
+int ult_wait_any(ult_wait_obj_t *objs, size_t count, long timeout_us, size_t *index);
+
+#endif
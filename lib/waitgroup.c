@@ -0,0 +1,118 @@
+#include "waitgroup.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static ult_waitgroup_t waitgroups[MAX_SYNC_COUNT];
+static size_t waitgroup_count = 0;
+
+static bool valid_waitgroup(wgid_t wgid) {
+    return wgid < waitgroup_count && waitgroups[wgid].id != (wgid_t)-1;
+}
+
+int ult_waitgroup_init(wgid_t *wgid) {
+    if (MAX_SYNC_COUNT - 1 == waitgroup_count) {
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+    ult_waitgroup_t *wg = &waitgroups[waitgroup_count];
+    wg->id = waitgroup_count;
+    wg->counter = 0;
+    wg->waiting_count = 0;
+    memset(wg->waiting_threads, 0, sizeof(bool) * MAX_THREADS_COUNT);
+
+    *wgid = waitgroup_count;
+    waitgroup_count++;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+int ult_waitgroup_add(wgid_t wgid, long delta) {
+    block_signals();
+
+    if (!valid_waitgroup(wgid)) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_waitgroup_t *wg = &waitgroups[wgid];
+    if (wg->counter + delta < 0) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    wg->counter += delta;
+
+    // the last done wakes every waiter, nothing before that does
+    if (wg->counter == 0) {
+        for (size_t i = 0; i < MAX_THREADS_COUNT && wg->waiting_count > 0; i++) {
+            if (wg->waiting_threads[i]) {
+                wg->waiting_threads[i] = false;
+                wg->waiting_count--;
+
+                ult_t *thread = get_thread_by_slot(i);
+                if (thread != NULL) {
+                    ult_make_ready(thread);
+                }
+            }
+        }
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_waitgroup_done(wgid_t wgid) {
+    return ult_waitgroup_add(wgid, -1);
+}
+
+int ult_waitgroup_wait(wgid_t wgid) {
+    block_signals();
+
+    if (!valid_waitgroup(wgid)) {
+        unblock_signals();
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_waitgroup_t *wg = &waitgroups[wgid];
+    ult_t *current = get_current_thread();
+    size_t self = ULT_TID_SLOT(current->tid);
+
+    while (wg->counter > 0) {
+        if (!wg->waiting_threads[self]) {
+            wg->waiting_threads[self] = true;
+            wg->waiting_count++;
+        }
+        current->state = ULT_BLOCKED;
+
+        unblock_signals();
+        ult_yield();
+        block_signals();
+    }
+
+    unblock_signals();
+    return EXIT_SUCCESS;
+}
+
+int ult_waitgroup_destroy(wgid_t wgid) {
+    if (!valid_waitgroup(wgid)) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    ult_waitgroup_t *wg = &waitgroups[wgid];
+    if (wg->waiting_count > 0) {
+        errno = EBUSY;
+        return EXIT_FAILURE;
+    }
+
+    wg->id = -1;
+    return EXIT_SUCCESS;
+}
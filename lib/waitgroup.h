@@ -0,0 +1,22 @@
+#ifndef ULT_WAITGROUP_H
+#define ULT_WAITGROUP_H
+
+#include "ult.h"
+#include <stdbool.h>
+
+typedef size_t wgid_t;
+
+typedef struct {
+    wgid_t id;
+    long counter;                              // outstanding work items
+    size_t waiting_count;
+    bool waiting_threads[MAX_THREADS_COUNT];   // woken once, when counter reaches zero
+} ult_waitgroup_t;
+
+int ult_waitgroup_init(wgid_t *wgid);
+int ult_waitgroup_add(wgid_t wgid, long delta);
+int ult_waitgroup_done(wgid_t wgid);
+int ult_waitgroup_wait(wgid_t wgid);
+int ult_waitgroup_destroy(wgid_t wgid);
+
+#endif
@@ -0,0 +1,142 @@
+#include "watchdog.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool enabled = false;
+static uint64_t threshold_ns = 0;
+static uint64_t period_ns = 0;       // the itimer interval, 0 until the scheduler is armed
+static uint64_t armed_at = 0;
+static uint64_t last_expiry = 0;     // expiry of the last tick accounted for
+static ult_watchdog_stats_t stats;
+
+int ult_watchdog_enable(long threshold_usec) {
+    if (threshold_usec < 0) {
+        errno = EINVAL;
+        return EXIT_FAILURE;
+    }
+
+    block_signals();
+    memset(&stats, 0, sizeof(stats));
+    threshold_ns = (uint64_t)threshold_usec * 1000;
+    ult_watchdog_resync();
+    enabled = true;
+    unblock_signals();
+
+    return EXIT_SUCCESS;
+}
+
+void ult_watchdog_disable(void) {
+    enabled = false;
+}
+
+bool ult_watchdog_enabled(void) {
+    return enabled;
+}
+
+void ult_watchdog_get(ult_watchdog_stats_t *out) {
+    block_signals();
+    *out = stats;
+    unblock_signals();
+}
+
+void ult_watchdog_arm(uint64_t period) {
+    period_ns = period;
+    armed_at = now_ns();
+    last_expiry = armed_at;
+}
+
+// the timer keeps its phase, only forget the ticks that were dropped on purpose
+void ult_watchdog_resync(void) {
+    if (0 == period_ns) {
+        return;
+    }
+    uint64_t now = now_ns();
+    last_expiry = armed_at + (now - armed_at) / period_ns * period_ns;
+}
+
+static size_t append_str(char *buf, size_t n, size_t size, const char *s) {
+    while (*s != '\0' && n < size - 1) {
+        buf[n++] = *s++;
+    }
+    return n;
+}
+
+static size_t append_num(char *buf, size_t n, size_t size, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (count > 0 && n < size - 1) {
+        buf[n++] = digits[--count];
+    }
+    return n;
+}
+
+static size_t bucket_of(uint64_t latency_ns) {
+    size_t b = 0;
+    for (uint64_t us = latency_ns / 1000; us > 0 && b < ULT_WATCHDOG_BUCKETS - 1; us >>= 1) {
+        b++;
+    }
+    return b;
+}
+
+static void record_worst(ult_watchdog_event_t event) {
+    size_t i = stats.worst_count;
+    if (i == ULT_WATCHDOG_WORST) {
+        if (event.latency_ns <= stats.worst[i - 1].latency_ns) {
+            return;
+        }
+        i--;
+    } else {
+        stats.worst_count++;
+    }
+
+    // insertion into the sorted list, longest first
+    while (i > 0 && stats.worst[i - 1].latency_ns < event.latency_ns) {
+        stats.worst[i] = stats.worst[i - 1];
+        i--;
+    }
+    stats.worst[i] = event;
+}
+
+void ult_watchdog_tick(tid_t running, const char *site, const char *where) {
+    if (!enabled || 0 == period_ns) {
+        return;
+    }
+
+    // a pending SIGALRM is not queued twice: this delivery belongs to the first
+    // expiry after the last one accounted for, any later ones were merged into it
+    uint64_t now = now_ns();
+    uint64_t expiry = last_expiry + period_ns;
+    uint64_t latency = now > expiry ? now - expiry : 0;
+    ult_watchdog_resync();
+
+    stats.ticks++;
+    if (latency > period_ns) {
+        stats.overruns++;
+    }
+    stats.histogram[bucket_of(latency)]++;
+    record_worst((ult_watchdog_event_t){latency, running, site, where});
+
+    if (0 != threshold_ns && latency > threshold_ns) {
+        // this runs on the ULT stack right above a signal frame, and may have
+        // interrupted stdio: build the line by hand and write(2) it
+        char line[256];
+        size_t n = 0;
+        n = append_str(line, n, sizeof(line), "watchdog: tick ");
+        n = append_num(line, n, sizeof(line), latency / 1000);
+        n = append_str(line, n, sizeof(line), " us late on thread ");
+        n = append_num(line, n, sizeof(line), running);
+        n = append_str(line, n, sizeof(line), ", preemption disabled by ");
+        n = append_str(line, n, sizeof(line), site);
+        n = append_str(line, n, sizeof(line), " (");
+        n = append_str(line, n, sizeof(line), where);
+        n = append_str(line, n, sizeof(line), ")\n");
+        write(STDERR_FILENO, line, n);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ULT_WATCHDOG_H
+#define ULT_WATCHDOG_H
+
+#include "ult.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Preemption latency: how long after its timer expired each SIGALRM tick got to
+// run the scheduler. A tick that fires while a ULT has signals blocked waits for
+// the matching unblock_signals(), so late ticks are charged to the function
+// that blocked them last (block_signals records it, see utils.h).
+
+#define ULT_WATCHDOG_BUCKETS 16   // bucket i counts latencies below 2^i us, the last one the rest
+#define ULT_WATCHDOG_WORST 8
+
+typedef struct {
+    uint64_t latency_ns;
+    tid_t tid;              // thread running when the tick was delivered
+    const char *site;       // function that had preemption disabled
+    const char *where;      // file:line of its block_signals()
+} ult_watchdog_event_t;
+
+typedef struct {
+    unsigned long ticks;
+    unsigned long overruns;                       // ticks later than a whole quantum
+    unsigned long histogram[ULT_WATCHDOG_BUCKETS];
+    ult_watchdog_event_t worst[ULT_WATCHDOG_WORST];   // longest first
+    size_t worst_count;
+} ult_watchdog_stats_t;
+
+// threshold_usec > 0 also logs every tick later than that to stderr
+int ult_watchdog_enable(long threshold_usec);
+void ult_watchdog_disable(void);
+bool ult_watchdog_enabled(void);
+void ult_watchdog_get(ult_watchdog_stats_t *stats);
+
+// scheduler side, SIGALRM must be blocked
+void ult_watchdog_arm(uint64_t period_ns);
+void ult_watchdog_resync(void);
+void ult_watchdog_tick(tid_t running, const char *site, const char *where);
+
+#endif
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/utils.h"
+#include "lib/watchdog.h"
+
+#define QUANTUM_US 5000
+#define RUN_MS 1000
+#define LOG_LINES 20000
+
+tid_t lock;
+long shared = 0;
+volatile uint64_t sink;
+char log_buffer[LOG_LINES * 64];
+
+// well behaved: short critical sections through the mutex, long stretches of plain work
+void* worker(void* arg) {
+    uint64_t stop = now_ns() + RUN_MS * 1000000ULL;
+    uint64_t x = (uint64_t)arg;
+    while (now_ns() < stop) {
+        for (int i = 0; i < 1000000; i++) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        ult_mutex_lock(lock);
+        shared++;
+        ult_mutex_unlock(lock);
+    }
+    sink = x;
+    return NULL;
+}
+
+// formats a whole batch of lines with preemption disabled, like a slow printf under a lock
+void flush_log(int batch) {
+    block_signals();
+    size_t used = 0;
+    for (int i = 0; i < LOG_LINES; i++) {
+        used += snprintf(log_buffer + used, sizeof(log_buffer) - used, "batch %d line %d value %ld\n", batch, i, shared);
+    }
+    unblock_signals();
+}
+
+void* logger(void* arg) {
+    uint64_t stop = now_ns() + RUN_MS * 1000000ULL;
+    for (int batch = 0; now_ns() < stop; batch++) {
+        flush_log(batch);
+        ult_sleep(50000);
+    }
+    return NULL;
+}
+
+int main() {
+    if (ult_init(QUANTUM_US) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    ult_mutex_init(&lock);
+    // log every tick that comes more than a whole quantum late
+    ult_watchdog_enable(QUANTUM_US);
+
+    tid_t threads[4];
+    for (int i = 0; i < 3; i++) {
+        ult_create(&threads[i], worker, (void*)(long)(i + 1));
+    }
+    ult_create(&threads[3], logger, NULL);
+    for (int i = 0; i < 4; i++) {
+        ult_join(threads[i], NULL);
+    }
+
+    ult_watchdog_stats_t stats;
+    ult_watchdog_get(&stats);
+    ult_watchdog_disable();
+
+    printf("\n%lu ticks, %lu later than the %d us quantum\n", stats.ticks, stats.overruns, QUANTUM_US);
+    printf("Preemption latency:\n");
+    for (int i = 0; i < ULT_WATCHDOG_BUCKETS; i++) {
+        if (stats.histogram[i] == 0) {
+            continue;
+        }
+        if (i == ULT_WATCHDOG_BUCKETS - 1) {
+            printf("  >= %6d us: %lu\n", 1 << (i - 1), stats.histogram[i]);
+        } else {
+            printf("  <  %6d us: %lu\n", 1 << i, stats.histogram[i]);
+        }
+    }
+    printf("Worst ticks:\n");
+    for (size_t i = 0; i < stats.worst_count; i++) {
+        ult_watchdog_event_t* e = &stats.worst[i];
+        printf("  %8.3f ms  thread %lu  %s (%s)\n", e->latency_ns / 1e6, e->tid, e->site, e->where);
+    }
+    return EXIT_SUCCESS;
+}
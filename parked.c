@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lib/ult.h"
+#include "lib/group.h"
+#include "lib/shstack.h"
+#include "lib/waitgroup.h"
+
+#define NUM_PARKED (MAX_THREADS_COUNT - 10)
+#define SHARED_STACK_SIZE (256 * 1024)
+#define DEPTH 4
+
+wgid_t gate;
+volatile long parked = 0;
+long corrupted = 0;
+
+size_t resident_bytes() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == NULL || fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+    return (size_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+// a few frames of locals that must survive being copied out and back
+void descend(int depth, long seed) {
+    long locals[8];
+    for (int i = 0; i < 8; i++) {
+        locals[i] = seed * 31 + i;
+    }
+
+    if (depth == 0) {
+        parked++;
+        ult_waitgroup_wait(gate);
+    } else {
+        descend(depth - 1, seed + 1);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        if (locals[i] != seed * 31 + i) {
+            corrupted++;
+            return;
+        }
+    }
+}
+
+void* park(void* arg) {
+    descend(DEPTH, (long)arg);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    bool shared = !(argc > 1 && strcmp(argv[1], "private") == 0);
+
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    grpid_t group;
+    ult_group_create(&group, ULT_GROUP_DEFAULT_WEIGHT);
+    if (shared && ult_group_set_shared_stack(group, SHARED_STACK_SIZE) != EXIT_SUCCESS) {
+        printf("Failed to set up the shared stack\n");
+        return EXIT_FAILURE;
+    }
+    ult_waitgroup_init(&gate);
+    ult_waitgroup_add(gate, 1);
+
+    size_t before = resident_bytes();
+    static tid_t threads[NUM_PARKED];
+    for (long i = 0; i < NUM_PARKED; i++) {
+        if (ult_create_in_group(&threads[i], group, park, (void*)i) != EXIT_SUCCESS) {
+            printf("Failed to create thread %ld\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    while (parked < NUM_PARKED) {
+        ult_sleep(1000);
+    }
+    size_t growth = resident_bytes() - before;
+
+    size_t reserved = 0, saved = 0;
+    ult_shstack_get_usage(&reserved, &saved);
+
+    ult_waitgroup_done(gate);
+    for (int i = 0; i < NUM_PARKED; i++) {
+        ult_join(threads[i], NULL);
+    }
+
+    printf("%s stacks: %d parked threads, resident growth %zu KB (%zu bytes per thread)\n",
+           shared ? "Shared" : "Private", NUM_PARKED, growth / 1024, growth / NUM_PARKED);
+    if (shared) {
+        printf("Stack copies: %zu bytes live (%zu per thread), %zu KB reserved\n",
+               saved, saved / NUM_PARKED, reserved / 1024);
+    }
+    printf("A million parked threads would take about %zu MB, corrupted frames: %ld\n",
+           growth / NUM_PARKED * 1000000 / (1024 * 1024), corrupted);
+    return corrupted == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/cond.h"
+#include "lib/utils.h"
+
+#define NUM_MESSAGES 500
+#define NUM_HOGS 3
+
+// a producer and a consumer passing one message at a time through a single slot,
+// next to threads that burn their whole timeslice. Without handoff every wakeup
+// waits behind the hogs in the run queue, with it the woken thread runs next
+tid_t mutex_id;
+cid_t not_full;
+cid_t not_empty;
+bool full = false;
+long posted_at;
+long total_latency = 0;
+long worst_latency = 0;
+volatile bool done = false;
+
+void* producer(void* arg) {
+    for (int i = 0; i < NUM_MESSAGES; i++) {
+        ult_mutex_lock(mutex_id);
+        while (full) {
+            ult_cond_wait(not_full, mutex_id);
+        }
+        posted_at = now_ns();
+        full = true;
+        ult_cond_signal(not_empty);
+        ult_mutex_unlock(mutex_id);
+    }
+    return NULL;
+}
+
+void* consumer(void* arg) {
+    for (int i = 0; i < NUM_MESSAGES; i++) {
+        ult_mutex_lock(mutex_id);
+        while (!full) {
+            ult_cond_wait(not_empty, mutex_id);
+        }
+        long latency = now_ns() - posted_at;
+        total_latency += latency;
+        if (latency > worst_latency) {
+            worst_latency = latency;
+        }
+        full = false;
+        ult_cond_signal(not_full);
+        ult_mutex_unlock(mutex_id);
+    }
+    done = true;
+    return NULL;
+}
+
+void* hog(void* arg) {
+    while (!done) {
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    bool handoff = argc > 1 && strcmp(argv[1], "handoff") == 0;
+
+    ult_config_t config = {.quantum = 1000, .handoff = handoff};
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    if (ult_mutex_init(&mutex_id) != EXIT_SUCCESS ||
+        ult_cond_init(&not_full) != EXIT_SUCCESS ||
+        ult_cond_init(&not_empty) != EXIT_SUCCESS) {
+        printf("Failed to initialize synchronization primitives\n");
+        return EXIT_FAILURE;
+    }
+
+    tid_t hogs[NUM_HOGS];
+    tid_t producer_thread, consumer_thread;
+    for (int i = 0; i < NUM_HOGS; i++) {
+        ult_create(&hogs[i], hog, NULL);
+    }
+    ult_create(&consumer_thread, consumer, NULL);
+    ult_create(&producer_thread, producer, NULL);
+
+    long start = now_ns();
+    ult_join(producer_thread, NULL);
+    ult_join(consumer_thread, NULL);
+    long elapsed = now_ns() - start;
+    for (int i = 0; i < NUM_HOGS; i++) {
+        ult_join(hogs[i], NULL);
+    }
+
+    printf("\n%d messages next to %d busy threads, handoff %s\n",
+           NUM_MESSAGES, NUM_HOGS, handoff ? "on" : "off");
+    printf("latency: %.1f us mean, %.1f us worst\n",
+           total_latency / 1000.0 / NUM_MESSAGES, worst_latency / 1000.0);
+    printf("total:   %.1f ms\n", elapsed / 1e6);
+    return EXIT_SUCCESS;
+}
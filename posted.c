@@ -0,0 +1,70 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "lib/ult.h"
+#include "lib/mutex.h"
+#include "lib/cond.h"
+#include "lib/inbox.h"
+#include "lib/utils.h"
+
+#define NUM_LOOKUPS 5
+#define LOOKUP_US 50000
+
+// the ULTs ask a resolver pthread (like a blocking DNS library) for answers and
+// wait on a condition variable. The only thing that can wake them is the
+// callback the resolver posts, so while it runs every ULT is blocked and the
+// runtime must idle on the inbox instead of reporting a deadlock
+tid_t lock;
+cid_t answered;
+long answers[NUM_LOOKUPS];
+int answer_count = 0;
+
+void deliver(void* arg) {
+    ult_mutex_lock(lock);
+    answers[answer_count++] = (long)arg;
+    ult_cond_signal(answered);
+    ult_mutex_unlock(lock);
+}
+
+void* resolver(void* arg) {
+    for (long i = 0; i < NUM_LOOKUPS; i++) {
+        usleep(LOOKUP_US);
+        ult_post(deliver, (void*)(i * i));
+    }
+    return NULL;
+}
+
+int main() {
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    if (ult_inbox_init() != EXIT_SUCCESS) {
+        perror("Failed to initialize the foreign inbox");
+        return EXIT_FAILURE;
+    }
+    if (ult_mutex_init(&lock) != EXIT_SUCCESS || ult_cond_init(&answered) != EXIT_SUCCESS) {
+        printf("Failed to initialize synchronization primitives\n");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t thread;
+    if (ult_foreign_create(&thread, resolver, NULL) != EXIT_SUCCESS) {
+        perror("Failed to create resolver thread");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start = now_ns();
+    ult_mutex_lock(lock);
+    while (answer_count < NUM_LOOKUPS) {
+        ult_cond_wait(answered, lock);
+        printf("answer %d: %ld after %.1f ms\n", answer_count, answers[answer_count - 1],
+               (now_ns() - start) / 1e6);
+    }
+    ult_mutex_unlock(lock);
+
+    pthread_join(thread, NULL);
+    printf("%d answers posted by a foreign thread while every ULT was blocked\n", answer_count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/rcu.h"
+
+#define NUM_READERS 8
+#define NUM_UPDATES 5000
+#define POISON -1
+
+typedef struct {
+    long version;
+    long a;
+    long b;
+    long checksum;     // version + a + b, POISON once retired
+} config_t;
+
+config_t* current_config;
+volatile bool stop = false;
+long reads[NUM_READERS];
+long violations = 0;
+long reclaimed = 0;
+
+// runs after a grace period: no reader can still see the old version
+void retire(void* ptr) {
+    config_t* c = ptr;
+    c->checksum = POISON;
+    free(c);
+    reclaimed++;
+}
+
+void* reader(void* arg) {
+    long id = (long)arg;
+    while (!stop) {
+        ult_rcu_read_lock();
+        config_t* c = ult_rcu_dereference(current_config);
+        if (c->checksum != c->version + c->a + c->b) {
+            violations++;
+        }
+
+        // sometimes get switched out inside the section, the writer must wait for us
+        if (reads[id] % 1000 == 0) {
+            ult_yield();
+            if (c->checksum != c->version + c->a + c->b) {
+                violations++;
+            }
+        }
+        ult_rcu_read_unlock();
+        reads[id]++;
+    }
+    return NULL;
+}
+
+void* writer(void* arg) {
+    for (long v = 1; v <= NUM_UPDATES; v++) {
+        config_t* next = malloc(sizeof(config_t));
+        next->version = v;
+        next->a = v * 3;
+        next->b = v * 7;
+        next->checksum = next->version + next->a + next->b;
+
+        config_t* old = current_config;
+        ult_rcu_assign_pointer(current_config, next);
+        ult_call_rcu(retire, old);
+
+        // a slow path now and then: wait for the readers in place
+        if (v % 1000 == 0) {
+            ult_synchronize_rcu();
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    if (ult_init(1000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    current_config = calloc(1, sizeof(config_t));
+
+    tid_t readers[NUM_READERS];
+    for (long i = 0; i < NUM_READERS; i++) {
+        ult_create(&readers[i], reader, (void*)i);
+    }
+    tid_t writer_thread;
+    ult_create(&writer_thread, writer, NULL);
+
+    ult_join(writer_thread, NULL);
+    stop = true;
+    for (int i = 0; i < NUM_READERS; i++) {
+        ult_join(readers[i], NULL);
+    }
+    ult_rcu_barrier();
+
+    long total = 0;
+    for (int i = 0; i < NUM_READERS; i++) {
+        total += reads[i];
+    }
+    printf("Reads: %ld, updates: %d, grace periods: %lu, reclaimed: %ld, violations: %ld\n",
+           total, NUM_UPDATES, ult_rcu_get_grace_periods(), reclaimed, violations);
+
+    free(current_config);
+    return violations == 0 && reclaimed == NUM_UPDATES ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/utils.h"
+#include "lib/waitgroup.h"
+
+// build with -DMAX_THREADS_COUNT=N to change the size of the thread table
+#define NUM_THREADS (MAX_THREADS_COUNT - 10)
+#define PING_SWITCHES 20000
+#define TOTAL_SWITCHES 2000000L
+
+wgid_t gate;
+long rounds = 0;
+
+// two threads bouncing the CPU while everybody else is parked:
+// every round the scheduler walks past all the parked entries
+void* ping(void* arg) {
+    for (int i = 0; i < PING_SWITCHES / 2; i++) {
+        ult_yield();
+    }
+    return NULL;
+}
+
+void* parked(void* arg) {
+    ult_waitgroup_wait(gate);
+    for (long i = 0; i < rounds; i++) {
+        ult_yield();
+    }
+    return NULL;
+}
+
+int main() {
+    if (ult_init(100000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    ult_waitgroup_init(&gate);
+    ult_waitgroup_add(gate, 1);
+    rounds = TOTAL_SWITCHES / NUM_THREADS;
+
+    tid_t a, b;
+    ult_create(&a, ping, NULL);
+    ult_create(&b, ping, NULL);
+
+    tid_t* threads = malloc(NUM_THREADS * sizeof(tid_t));
+    for (int i = 0; i < NUM_THREADS; i++) {
+        if (ult_create(&threads[i], parked, NULL) != EXIT_SUCCESS) {
+            printf("Failed to create thread %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // let every thread park first, then time the ping pong
+    ult_yield();
+    uint64_t start = now_ns();
+    ult_join(a, NULL);
+    ult_join(b, NULL);
+    uint64_t scan = now_ns() - start;
+
+    ult_waitgroup_done(gate);
+    start = now_ns();
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ult_join(threads[i], NULL);
+    }
+    uint64_t busy = now_ns() - start;
+
+    printf("%6d threads: %8.0f ns per switch past parked threads (%.2f ns per entry), "
+           "%5.0f ns per switch when all are ready\n",
+           NUM_THREADS, (double)scan / PING_SWITCHES, (double)scan / PING_SWITCHES / (NUM_THREADS / 2.0),
+           (double)busy / (rounds * NUM_THREADS));
+    free(threads);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "lib/ult.hpp"
+
+extern "C" {
+#include "lib/utils.h"
+}
+
+#define NUM_SPAWNS 500
+#define QUEUE_SIZE 8
+#define ITEMS 200
+
+// every heap allocation of the program goes through here
+static unsigned long allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// bounded queue between a producer and a consumer, no allocation either
+struct queue {
+    long items[QUEUE_SIZE];
+    size_t head = 0, count = 0;
+    ult::mutex lock;
+    ult::condition_variable changed;
+};
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    // spawn and join: a lambda with captures plus by-value arguments
+    long total = 0;
+    unsigned long before = allocations;
+    uint64_t start = now_ns();
+    for (long i = 0; i < NUM_SPAWNS; i++) {
+        ult::thread t([&total](long a, long b) { total += a * b; }, i, 2L);
+    }
+    double spawn_ns = (double)(now_ns() - start) / NUM_SPAWNS;
+    unsigned long spawn_allocations = allocations - before;
+
+    queue q;
+    long consumed = 0;
+    {
+        ult::thread producer([&q] {
+            for (long i = 1; i <= ITEMS; i++) {
+                ult::unique_lock<ult::mutex> lock(q.lock);
+                q.changed.wait(lock, [&q] { return q.count < QUEUE_SIZE; });
+                q.items[(q.head + q.count++) % QUEUE_SIZE] = i;
+                q.changed.notify_all();
+            }
+        });
+        ult::thread consumer([&q, &consumed] {
+            for (long i = 0; i < ITEMS; i++) {
+                ult::unique_lock<ult::mutex> lock(q.lock);
+                q.changed.wait(lock, [&q] { return q.count > 0; });
+                consumed += q.items[q.head];
+                q.head = (q.head + 1) % QUEUE_SIZE;
+                q.count--;
+                q.changed.notify_all();
+            }
+        });
+    }
+
+    printf("\n%d spawns: total %ld (expected %ld), %.0f ns per spawn and join, %lu heap allocations\n",
+           NUM_SPAWNS, total, (long)NUM_SPAWNS * (NUM_SPAWNS - 1), spawn_ns, spawn_allocations);
+    printf("producer/consumer: sum %ld (expected %ld)\n", consumed, (long)ITEMS * (ITEMS + 1) / 2);
+    return EXIT_SUCCESS;
+}
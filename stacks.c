@@ -0,0 +1,124 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/stackuse.h"
+#include "lib/utils.h"
+#include "lib/waitgroup.h"
+
+#define NUM_ROUTINES 4
+#define PER_ROUTINE 50
+#define ROUNDS 3
+#define SPIN_NS 1500000
+#define FIXED_STACK (12 * 1024)   // one size for all has to fit renderer, preempted at its deepest
+
+// four kinds of workers with very different stack depths: one only blocks, the
+// others are preempted at their deepest point. Every round keeps all of them
+// alive at once and reports the heap their stacks take. Without measurements
+// every thread gets FIXED_STACK; with `adaptive` the later rounds get stacks
+// sized by the marks of the earlier ones
+wgid_t all_started;
+wgid_t gate;
+
+static void spin() {
+    uint64_t until = now_ns() + SPIN_NS;
+    while (now_ns() < until) {
+    }
+}
+
+// recursion with a frame of about `frame` bytes, spinning at the bottom
+static long descend(int depth, int frame) {
+    volatile char buffer[frame];
+    memset((char*)buffer, depth, frame);
+    if (0 == depth) {
+        spin();
+        return buffer[0];
+    }
+    return descend(depth - 1, frame) + buffer[frame - 1];
+}
+
+static void arrive() {
+    ult_waitgroup_done(all_started);
+    ult_waitgroup_wait(gate);
+}
+
+void* sleeper(void* arg) {
+    ult_sleep(SPIN_NS / 1000);
+    arrive();
+    return NULL;
+}
+
+void* ticker(void* arg) {
+    spin();
+    arrive();
+    return NULL;
+}
+
+void* parser(void* arg) {
+    long r = descend(8, 128);
+    arrive();
+    return (void*)r;
+}
+
+void* renderer(void* arg) {
+    long r = descend(6, 400);
+    arrive();
+    return (void*)r;
+}
+
+static const char* name_of(void* (*routine)(void*)) {
+    return routine == sleeper ? "sleeper" : routine == ticker ? "ticker" : routine == parser ? "parser" : routine == renderer ? "renderer" : "other";
+}
+
+int main(int argc, char* argv[]) {
+    bool adaptive = argc > 1 && strcmp(argv[1], "adaptive") == 0;
+
+    ult_config_t config = {.quantum = 1000, .stack_size = FIXED_STACK};
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    ult_stack_usage_enable(adaptive);
+
+    void* (*routines[])(void*) = {sleeper, ticker, parser, renderer};
+    tid_t threads[NUM_ROUTINES * PER_ROUTINE];
+    size_t heap[ROUNDS];
+
+    size_t baseline = mallinfo2().uordblks;
+    for (int round = 0; round < ROUNDS; round++) {
+        ult_waitgroup_init(&all_started);
+        ult_waitgroup_init(&gate);
+        ult_waitgroup_add(all_started, NUM_ROUTINES * PER_ROUTINE);
+        ult_waitgroup_add(gate, 1);
+
+        for (int i = 0; i < NUM_ROUTINES * PER_ROUTINE; i++) {
+            ult_create(&threads[i], routines[i % NUM_ROUTINES], NULL);
+        }
+        // joined threads keep their stacks for the next round, unless the size changes
+        heap[round] = mallinfo2().uordblks - baseline;
+
+        ult_waitgroup_wait(all_started);
+        ult_waitgroup_done(gate);
+        for (int i = 0; i < NUM_ROUTINES * PER_ROUTINE; i++) {
+            ult_join(threads[i], NULL);
+        }
+    }
+
+    ult_stack_usage_t usage[ULT_STACK_ROUTINES];
+    size_t n = ult_stack_usage_get(usage, ULT_STACK_ROUTINES);
+    printf("\n%-10s %8s %10s %10s %10s %10s %10s\n", "routine", "threads", "max used", "mean used",
+           "preempted", "exhausted", "next size");
+    for (size_t i = 0; i < n; i++) {
+        printf("%-10s %8lu %10zu %10zu %10zu %10lu %10zu\n", name_of(usage[i].routine), usage[i].threads,
+               usage[i].max_used, usage[i].total_used / usage[i].threads, usage[i].max_preempted,
+               usage[i].exhausted, usage[i].stack_size);
+    }
+    printf("\nlargest SIGALRM frame: %zu bytes\n", ult_stack_signal_frame());
+    printf("heap taken by the stacks of %d live threads, %s sizes:\n", NUM_ROUTINES * PER_ROUTINE,
+           adaptive ? "adaptive" : "fixed");
+    for (int round = 0; round < ROUNDS; round++) {
+        printf("round %d: %zu KB\n", round, heap[round] / 1024);
+    }
+    return EXIT_SUCCESS;
+}
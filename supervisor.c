@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/waitgroup.h"
+#include "lib/utils.h"
+
+#define NUM_BATCHES 6
+#define BATCH_SIZE 500     // NUM_BATCHES * BATCH_SIZE is well over MAX_THREADS_COUNT
+#define NUM_CHILDREN 5
+
+wgid_t batch_group;
+long processed = 0;
+
+void* batch_worker(void* arg) {
+    __atomic_fetch_add(&processed, 1, __ATOMIC_RELAXED);
+    ult_waitgroup_done(batch_group);
+    return NULL;
+}
+
+void* child(void* arg) {
+    long steps = (long)arg;
+    for (long i = 0; i < steps; i++) {
+        ult_yield();
+    }
+    return (void*)steps;
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    if (ult_waitgroup_init(&batch_group) != EXIT_SUCCESS) {
+        printf("Failed to initialize wait group\n");
+        return EXIT_FAILURE;
+    }
+
+    // detached workers give their slot back on exit, so batches can keep coming
+    for (int batch = 0; batch < NUM_BATCHES; batch++) {
+        ult_waitgroup_add(batch_group, BATCH_SIZE);
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            tid_t tid;
+            if (ult_create(&tid, batch_worker, NULL) != EXIT_SUCCESS) {
+                printf("Failed to create worker %d of batch %d\n", i, batch);
+                return EXIT_FAILURE;
+            }
+            ult_detach(tid);
+        }
+        ult_waitgroup_wait(batch_group);
+        printf("Batch %d done, %ld workers so far, %zu thread slots allocated\n",
+               batch, processed, ult_get_thread_count());
+    }
+
+    tid_t children[NUM_CHILDREN];
+    long steps[NUM_CHILDREN] = {40, 10, 30, 0, 20};
+    for (int i = 0; i < NUM_CHILDREN; i++) {
+        if (ult_create(&children[i], child, (void*)steps[i]) != EXIT_SUCCESS) {
+            printf("Failed to create child %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // reap children in the order they finish
+    size_t remaining = NUM_CHILDREN;
+    while (remaining > 0) {
+        size_t index;
+        void* result;
+        if (ult_join_any(children, remaining, &index, &result) != EXIT_SUCCESS) {
+            printf("Failed to join children\n");
+            return EXIT_FAILURE;
+        }
+        printf("Child %lu (slot %zu) finished after %ld steps\n", children[index],
+               ULT_TID_SLOT(children[index]), (long)result);
+        children[index] = children[--remaining];
+    }
+
+    ult_waitgroup_destroy(batch_group);
+    printf("\nMain: all workers accounted for\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib/ult.h"
+#include "lib/executor.h"
+#include "lib/utils.h"
+
+#define NUM_WORKERS 8
+#define NUM_TASKS 1000000
+#define BULK_SIZE 1024
+#define NUM_SPAWNED 900    // ULTs are capped at MAX_THREADS_COUNT, so spawn fewer
+
+long counter = 0;
+
+// a single locked add, so a preemption cannot split the read-modify-write
+void tiny_task(void* arg) {
+    __atomic_fetch_add(&counter, (long)arg, __ATOMIC_RELAXED);
+}
+
+void* tiny_thread(void* arg) {
+    __atomic_fetch_add(&counter, (long)arg, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+double elapsed_ns(struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+
+    // baseline: one ULT per task
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tid_t threads[NUM_SPAWNED];
+    for (long i = 0; i < NUM_SPAWNED; i++) {
+        if (ult_create(&threads[i], tiny_thread, (void*)1L) != EXIT_SUCCESS) {
+            printf("Failed to create thread %ld\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int i = 0; i < NUM_SPAWNED; i++) {
+        ult_join(threads[i], NULL);
+    }
+    printf("ult_create per task: %d tasks, %.1f ns/task\n",
+           NUM_SPAWNED, elapsed_ns(&start) / NUM_SPAWNED);
+
+    ult_executor_t executor;
+    if (ult_executor_init(&executor, NUM_WORKERS) != EXIT_SUCCESS) {
+        printf("Failed to start the executor\n");
+        return EXIT_FAILURE;
+    }
+
+    // single submits
+    counter = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < NUM_TASKS; i++) {
+        ult_executor_submit(&executor, tiny_task, (void*)1L);
+    }
+    ult_executor_drain(&executor);
+    printf("executor submit:     %d tasks, %.1f ns/task (counter %ld)\n",
+           NUM_TASKS, elapsed_ns(&start) / NUM_TASKS, counter);
+
+    // bulk submits
+    void* args[BULK_SIZE];
+    for (int i = 0; i < BULK_SIZE; i++) {
+        args[i] = (void*)1L;
+    }
+
+    counter = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < NUM_TASKS / BULK_SIZE; i++) {
+        ult_executor_submit_bulk(&executor, tiny_task, args, BULK_SIZE);
+    }
+    ult_executor_drain(&executor);
+    long bulk_tasks = (NUM_TASKS / BULK_SIZE) * BULK_SIZE;
+    printf("executor bulk:       %ld tasks, %.1f ns/task (counter %ld)\n",
+           bulk_tasks, elapsed_ns(&start) / bulk_tasks, counter);
+
+    ult_executor_shutdown(&executor);
+    printf("\nMain: executor shut down\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/ult.h"
+#include "lib/group.h"
+#include "lib/sched.h"
+#include "lib/utils.h"
+
+#define RUN_US 1000000
+#define SMALL_THREADS 2
+#define BIG_THREADS 50
+#define CAPPED_THREADS 4
+#define CAPPED_QUOTA_US 10000     // 10% of the CPU
+#define CAPPED_PERIOD_US 100000
+
+volatile bool stop = false;
+
+void* busy(void* arg) {
+    volatile long work = 0;
+    while (!stop) {
+        work++;
+    }
+    return NULL;
+}
+
+// the big tenant spawns most of its threads itself, they land in its group
+void* big_leader(void* arg) {
+    tid_t children[BIG_THREADS - 1];
+    for (int i = 0; i < BIG_THREADS - 1; i++) {
+        ult_create(&children[i], busy, NULL);
+    }
+    busy(NULL);
+    for (int i = 0; i < BIG_THREADS - 1; i++) {
+        ult_join(children[i], NULL);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    ult_config_t config = {.quantum = 1000, .policy = &ult_sched_rr};
+    if (argc > 1 && strcmp(argv[1], "group") == 0) {
+        config.policy = &ult_sched_group;
+    }
+
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    grpid_t small, big, capped;
+    if (ult_group_create(&small, ULT_GROUP_DEFAULT_WEIGHT) != EXIT_SUCCESS ||
+        ult_group_create(&big, ULT_GROUP_DEFAULT_WEIGHT) != EXIT_SUCCESS ||
+        ult_group_create(&capped, ULT_GROUP_DEFAULT_WEIGHT) != EXIT_SUCCESS) {
+        printf("Failed to create groups\n");
+        return EXIT_FAILURE;
+    }
+    // only the group policy enforces quotas
+    uint64_t start = now_ns();
+    bool quota = ult_group_set_quota(capped, CAPPED_QUOTA_US, CAPPED_PERIOD_US) == EXIT_SUCCESS;
+
+    tid_t threads[SMALL_THREADS + 1 + CAPPED_THREADS];
+    int count = 0;
+    for (int i = 0; i < SMALL_THREADS; i++) {
+        ult_create_in_group(&threads[count++], small, busy, NULL);
+    }
+    ult_create_in_group(&threads[count++], big, big_leader, NULL);
+    for (int i = 0; i < CAPPED_THREADS; i++) {
+        ult_create_in_group(&threads[count++], capped, busy, NULL);
+    }
+
+    ult_sleep(RUN_US);
+    stop = true;
+    // quota periods started during the run, the last one usually only just
+    uint64_t periods = (now_ns() - start) / (CAPPED_PERIOD_US * 1000) + 1;
+    uint64_t capped_runtime = ult_group_get_runtime(capped);
+    for (int i = 0; i < count; i++) {
+        ult_join(threads[i], NULL);
+    }
+
+    double total = ult_group_get_runtime(small) + ult_group_get_runtime(big) +
+                   ult_group_get_runtime(capped);
+    printf("Policy %s, CPU share per tenant:\n", config.policy->name);
+    printf("  small  (%2d threads)            %5.1f%%\n", SMALL_THREADS,
+           100.0 * ult_group_get_runtime(small) / total);
+    printf("  big    (%2d threads)            %5.1f%%\n", BIG_THREADS,
+           100.0 * ult_group_get_runtime(big) / total);
+    printf("  capped (%2d threads, %s) %5.1f%%, %.1f ms per %d ms period, throttled %lu times\n",
+           CAPPED_THREADS, quota ? "10% quota" : "no quota ",
+           100.0 * ult_group_get_runtime(capped) / total, capped_runtime / 1e6 / periods,
+           CAPPED_PERIOD_US / 1000, ult_group_get_throttled(capped));
+    return EXIT_SUCCESS;
+}
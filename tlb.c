@@ -0,0 +1,105 @@
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "lib/ult.h"
+#include "lib/hugepage.h"
+#include "lib/utils.h"
+
+#define NUM_THREADS (MAX_THREADS_COUNT - 10)
+#define ROUNDS 200
+
+volatile long sink = 0;
+
+// touch a little of the stack on every turn, like a real thread would
+void* spin(void* arg) {
+    volatile char frame[512];
+    for (int r = 0; r < ROUNDS; r++) {
+        frame[(r * 64) % sizeof(frame)] = (char)r;
+        ult_yield();
+    }
+    sink += frame[0];
+    return NULL;
+}
+
+// anonymous memory of the process currently backed by transparent huge pages
+long huge_kb() {
+    char line[256];
+    long kb = 0;
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+// dTLB load misses of this kernel thread, -1 if the PMU is not available
+int open_dtlb_counter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.disabled = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int main(int argc, char** argv) {
+    ult_config_t config = {.quantum = 10000};
+    if (argc > 1 && strcmp(argv[1], "arena") == 0) {
+        config.huge_arena = true;
+        config.stack_guards = true;
+    }
+
+    if (ult_init_config(&config) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    static tid_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ult_create(&threads[i], spin, NULL);
+    }
+
+    int fd = open_dtlb_counter();
+    if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ult_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    long huge = huge_kb();
+
+    long long misses = -1;
+    if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+        close(fd);
+    }
+
+    long switches = (long)NUM_THREADS * ROUNDS;
+    printf("Arena %s (backing %s, %ld KB on huge pages): %d threads, %.0f ns per switch, ",
+           config.huge_arena ? "on" : "off", ult_arena_backing(), huge, NUM_THREADS,
+           (double)elapsed / switches);
+    if (misses >= 0) {
+        printf("%.3f dTLB misses per switch\n", (double)misses / switches);
+    } else {
+        printf("dTLB misses unavailable\n");
+    }
+    return EXIT_SUCCESS;
+}
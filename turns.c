@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/cond.h"
+#include "lib/mutex.h"
+
+#define NUM_WAITERS 16
+#define ROUNDS 10
+
+// a token passed around a ring of threads: every pass is broadcast to all of them,
+// but only the next one in the ring can do anything with it. The ring runs against
+// the round robin order, so the scheduler does not hand the token over by luck
+tid_t mutex_id;
+cid_t cond_id;
+long turn = 0;
+bool use_pred = false;
+
+bool my_turn(void* arg) {
+    return turn % NUM_WAITERS == NUM_WAITERS - 1 - (long)arg;
+}
+
+void* waiter(void* arg) {
+    for (int round = 0; round < ROUNDS; round++) {
+        ult_mutex_lock(mutex_id);
+        if (use_pred) {
+            ult_cond_wait_pred(cond_id, mutex_id, my_turn, arg);
+        } else {
+            while (!my_turn(arg)) {
+                ult_cond_wait(cond_id, mutex_id);
+            }
+        }
+        turn++;
+        ult_cond_broadcast(cond_id);
+        ult_mutex_unlock(mutex_id);
+    }
+    return NULL;
+}
+
+unsigned long run(bool pred) {
+    use_pred = pred;
+    turn = 0;
+    if (ult_cond_init(&cond_id) != EXIT_SUCCESS) {
+        printf("Failed to initialize condition variable\n");
+        exit(EXIT_FAILURE);
+    }
+
+    tid_t threads[NUM_WAITERS];
+    for (long i = 0; i < NUM_WAITERS; i++) {
+        ult_create(&threads[i], waiter, (void*)i);
+    }
+    for (int i = 0; i < NUM_WAITERS; i++) {
+        ult_join(threads[i], NULL);
+    }
+    return ult_cond_get_wakeups(cond_id);
+}
+
+int main() {
+    if (ult_init(10000) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+    if (ult_mutex_init(&mutex_id) != EXIT_SUCCESS) {
+        printf("Failed to initialize mutex\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned long plain = run(false);
+    unsigned long pred = run(true);
+
+    long passes = NUM_WAITERS * ROUNDS;
+    printf("\n%ld passes of the token between %d threads\n", passes, NUM_WAITERS);
+    printf("ult_cond_wait:      %5lu wakeups, %.2f per useful one\n", plain, (double)plain / passes);
+    printf("ult_cond_wait_pred: %5lu wakeups, %.2f per useful one\n", pred, (double)pred / passes);
+    return EXIT_SUCCESS;
+}
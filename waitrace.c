@@ -0,0 +1,70 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/ult.h"
+#include "lib/waitany.h"
+#include "lib/utils.h"
+
+#define QUANTUM_US 50
+#define ROUNDS 3000
+#define TIMEOUT_US 100000
+
+// regression check for ult_wait_any on a thread: the thread may exit while the
+// waiter has claimed it but is not parked yet (a tick right before ult_park), and
+// that exit must still wake it. With a 50us quantum, workers that run for up to
+// two quanta end at every point of the waiter's path; a wait that lasts until
+// its timeout lost its wakeup. Exits with a failure if any did
+static void spin(long ns) {
+    uint64_t until = now_ns() + ns;
+    while (now_ns() < until) {
+    }
+}
+
+void* worker(void* arg) {
+    spin((long)arg);
+    return arg;
+}
+
+int main(int argc, char* argv[]) {
+    if (ult_init(QUANTUM_US) != EXIT_SUCCESS) {
+        printf("Failed to initialize ULT library\n");
+        return EXIT_FAILURE;
+    }
+
+    long lost = 0, wrong = 0;
+    uint64_t worst = 0;
+    for (long i = 0; i < ROUNDS; i++) {
+        long ns = i * 7919 % (2 * QUANTUM_US * 1000);
+        tid_t tid;
+        if (ult_create(&tid, worker, (void*)ns) != EXIT_SUCCESS) {
+            printf("Failed to create worker %ld\n", i);
+            return EXIT_FAILURE;
+        }
+
+        ult_wait_obj_t obj = {.kind = ULT_WAIT_THREAD, .id = tid};
+        uint64_t start = now_ns();
+        int status = ult_wait_any(&obj, 1, TIMEOUT_US, NULL);
+        uint64_t waited = now_ns() - start;
+        if (status != EXIT_SUCCESS && errno != ETIMEDOUT) {
+            printf("ult_wait_any failed in round %ld\n", i);
+            return EXIT_FAILURE;
+        }
+
+        // the deadline check after the wakeup that never came still finds the exit
+        if (status != EXIT_SUCCESS || waited >= TIMEOUT_US * 1000) {
+            lost++;
+        }
+        if (status != EXIT_SUCCESS) {
+            ult_join(tid, NULL);
+        } else if ((long)obj.retval != ns) {
+            wrong++;
+        }
+        if (waited > worst) {
+            worst = waited;
+        }
+    }
+
+    printf("%d waits on exiting threads: %ld lost wakeups, %ld wrong results, worst wait %.1f us\n",
+           ROUNDS, lost, wrong, worst / 1e3);
+    return 0 == lost && 0 == wrong ? EXIT_SUCCESS : EXIT_FAILURE;
+}